@@ -0,0 +1,518 @@
+#include "bytecode.h"
+
+#include "statement.h"
+
+#include <optional>
+#include <typeinfo>
+
+using namespace std;
+
+namespace bytecode {
+
+    namespace {
+
+        using ComparatorFn = bool (*)(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+            runtime::Context&);
+
+        // Определяет код операции по функции сравнения, с которой был создан узел ast::Comparison
+        OpCode ComparisonOpCode(const ast::Comparison& node) {
+            const ComparatorFn* fn = node.GetComparator().target<ComparatorFn>();
+            if (fn != nullptr) {
+                if (*fn == runtime::Equal) return OpCode::Equal;
+                if (*fn == runtime::NotEqual) return OpCode::NotEqual;
+                if (*fn == runtime::Less) return OpCode::Less;
+                if (*fn == runtime::Greater) return OpCode::Greater;
+                if (*fn == runtime::LessOrEqual) return OpCode::LessOrEqual;
+                if (*fn == runtime::GreaterOrEqual) return OpCode::GreaterOrEqual;
+            }
+            throw CompileError("Unsupported comparator"s);
+        }
+
+        class Compiler {
+        public:
+            // Регистр 0 - self, регистры 1..params.size() - формальные параметры метода
+            Compiler(std::string name, const std::vector<runtime::Symbol>& params)
+                : function_(make_unique<Function>())
+            {
+                function_->name = move(name);
+                DeclareLocal(runtime::SELF);
+                for (runtime::Symbol param : params) {
+                    DeclareLocal(param);
+                }
+                function_->params = static_cast<Operand>(function_->locals.size());
+            }
+
+            // Программа верхнего уровня не имеет параметров
+            explicit Compiler(std::string name)
+                : function_(make_unique<Function>())
+            {
+                function_->name = move(name);
+            }
+
+            std::unique_ptr<Function> Compile(const ast::Statement& body) {
+                CollectLocals(body);
+                assigned_.assign(function_->locals.size(), false);
+                fill(assigned_.begin(), assigned_.begin() + function_->params, true);
+
+                CompileStatement(body);
+
+                Operand result = AllocTemp();
+                Emit(OpCode::LoadNone, result);
+                Emit(OpCode::Return, result);
+
+                function_->registers = static_cast<Operand>(function_->locals.size()) + max_temps_;
+                return move(function_);
+            }
+
+        private:
+            std::unique_ptr<Function> function_;
+            std::unordered_map<runtime::Symbol, Operand> locals_;
+            std::unordered_map<runtime::Symbol, Operand> names_;
+            // Переменные, которым гарантированно присвоено значение в текущей точке кода
+            std::vector<bool> assigned_;
+            Operand temps_ = 0;
+            Operand max_temps_ = 0;
+
+            Operand DeclareLocal(runtime::Symbol name) {
+                auto [it, inserted] = locals_.emplace(name, static_cast<Operand>(locals_.size()));
+                if (inserted) {
+                    function_->locals.push_back(name);
+                }
+                return it->second;
+            }
+
+            Operand Name(runtime::Symbol name) {
+                auto [it, inserted] = names_.emplace(name, static_cast<Operand>(function_->names.size()));
+                if (inserted) {
+                    function_->names.push_back(name);
+                }
+                return it->second;
+            }
+
+            Operand Constant(runtime::ObjectHolder value) {
+                function_->constants.push_back(move(value));
+                return static_cast<Operand>(function_->constants.size() - 1);
+            }
+
+            Operand CallSiteFor(runtime::Symbol method, size_t argc) {
+                function_->call_sites.push_back({ method, static_cast<Operand>(argc),
+                    runtime::InternMethodName(method) });
+                return static_cast<Operand>(function_->call_sites.size() - 1);
+            }
+
+            Operand NewFieldCache() {
+                function_->field_caches.emplace_back();
+                return static_cast<Operand>(function_->field_caches.size() - 1);
+            }
+
+            // Временные регистры нумеруются после регистров переменных
+            Operand AllocTemp() {
+                Operand reg = static_cast<Operand>(function_->locals.size()) + temps_++;
+                max_temps_ = max(max_temps_, temps_);
+                return reg;
+            }
+
+            size_t Emit(OpCode op, Operand a = 0, Operand b = 0, Operand c = 0, Operand d = 0) {
+                function_->code.push_back({ op, a, b, c, d });
+                return function_->code.size() - 1;
+            }
+
+            Operand Here() const {
+                return static_cast<Operand>(function_->code.size());
+            }
+
+            void PatchJump(size_t instruction) {
+                function_->code[instruction].a = Here();
+            }
+
+            // Собирает имена всех переменных, чтобы закрепить за ними регистры до генерации кода
+            void CollectLocals(const ast::Statement& node) {
+                if (auto p = dynamic_cast<const ast::Compound*>(&node)) {
+                    for (const auto& stmt : p->GetStatements()) {
+                        CollectLocals(*stmt);
+                    }
+                }
+                else if (auto p = dynamic_cast<const ast::MethodBody*>(&node)) {
+                    CollectLocals(p->GetBody());
+                }
+                else if (auto p = dynamic_cast<const ast::Assignment*>(&node)) {
+                    DeclareLocal(p->GetVarName());
+                    CollectLocals(p->GetRValue());
+                }
+                else if (auto p = dynamic_cast<const ast::VariableValue*>(&node)) {
+                    DeclareLocal(p->GetName());
+                }
+                else if (auto p = dynamic_cast<const ast::FieldAssignment*>(&node)) {
+                    CollectLocals(p->GetObject());
+                    CollectLocals(p->GetRValue());
+                }
+                else if (auto p = dynamic_cast<const ast::ClassDefinition*>(&node)) {
+                    DeclareLocal(p->GetClass().TryAs<runtime::Class>()->GetName());
+                }
+                else if (auto p = dynamic_cast<const ast::Print*>(&node)) {
+                    for (const auto& arg : p->GetArgs()) {
+                        CollectLocals(*arg);
+                    }
+                }
+                else if (auto p = dynamic_cast<const ast::MethodCall*>(&node)) {
+                    CollectLocals(p->GetObject());
+                    for (const auto& arg : p->GetArgs()) {
+                        CollectLocals(*arg);
+                    }
+                }
+                else if (auto p = dynamic_cast<const ast::NewInstance*>(&node)) {
+                    for (const auto& arg : p->GetArgs()) {
+                        CollectLocals(*arg);
+                    }
+                }
+                else if (auto p = dynamic_cast<const ast::UnaryOperation*>(&node)) {
+                    CollectLocals(p->GetArgument());
+                }
+                else if (auto p = dynamic_cast<const ast::BinaryOperation*>(&node)) {
+                    const vector<const ast::BinaryOperation*> chain = LeftChain(*p);
+                    CollectLocals(chain.back()->GetLhs());
+                    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                        CollectLocals((*it)->GetRhs());
+                    }
+                }
+                else if (auto p = dynamic_cast<const ast::Return*>(&node)) {
+                    CollectLocals(p->GetStatement());
+                }
+                else if (auto p = dynamic_cast<const ast::IfElse*>(&node)) {
+                    CollectLocals(p->GetCondition());
+                    CollectLocals(p->GetIfBody());
+                    if (p->GetElseBody() != nullptr) {
+                        CollectLocals(*p->GetElseBody());
+                    }
+                }
+            }
+
+            void CompileStatement(const ast::Statement& node) {
+                const Operand temps = temps_;
+
+                if (auto p = dynamic_cast<const ast::Compound*>(&node)) {
+                    for (const auto& stmt : p->GetStatements()) {
+                        CompileStatement(*stmt);
+                    }
+                }
+                else if (auto p = dynamic_cast<const ast::MethodBody*>(&node)) {
+                    CompileStatement(p->GetBody());
+                }
+                else if (auto p = dynamic_cast<const ast::Print*>(&node)) {
+                    bool first = true;
+                    for (const auto& arg : p->GetArgs()) {
+                        Emit(OpCode::PrintArg, 0, CompileExpression(*arg), first ? 0 : 1);
+                        first = false;
+                    }
+                    Emit(OpCode::PrintEnd);
+                }
+                else if (auto p = dynamic_cast<const ast::IfElse*>(&node)) {
+                    CompileIfElse(*p);
+                }
+                else if (auto p = dynamic_cast<const ast::Return*>(&node)) {
+                    Emit(OpCode::Return, CompileExpression(p->GetStatement()));
+                }
+                else if (auto p = dynamic_cast<const ast::ClassDefinition*>(&node)) {
+                    Operand reg = locals_.at(p->GetClass().TryAs<runtime::Class>()->GetName());
+                    Emit(OpCode::LoadConst, reg, Constant(p->GetClass()));
+                    assigned_[reg] = true;
+                }
+                else {
+                    CompileExpression(node);
+                }
+
+                temps_ = temps;
+            }
+
+            void CompileIfElse(const ast::IfElse& node) {
+                Operand condition = CompileExpression(node.GetCondition());
+                size_t jump_to_else = Emit(OpCode::JumpIfFalse, 0, condition);
+
+                const vector<bool> assigned_before = assigned_;
+                CompileStatement(node.GetIfBody());
+
+                if (node.GetElseBody() == nullptr) {
+                    PatchJump(jump_to_else);
+                    assigned_ = assigned_before;
+                    return;
+                }
+
+                size_t jump_to_end = Emit(OpCode::Jump);
+                PatchJump(jump_to_else);
+
+                vector<bool> assigned_in_if = move(assigned_);
+                assigned_ = assigned_before;
+                CompileStatement(*node.GetElseBody());
+                PatchJump(jump_to_end);
+
+                // После if/else переменная гарантированно связана, только если она связана в обеих ветках
+                for (size_t i = 0; i < assigned_.size(); ++i) {
+                    assigned_[i] = assigned_[i] && assigned_in_if[i];
+                }
+            }
+
+            // Возвращает регистр, в котором окажется значение выражения.
+            // Для чтения переменной это её собственный регистр
+            Operand CompileExpression(const ast::Statement& node) {
+                if (auto p = dynamic_cast<const ast::VariableValue*>(&node)) {
+                    if (p->GetDottedIds().empty()) {
+                        return ReadLocal(p->GetName());
+                    }
+                }
+                return CompileExpressionTo(node, nullopt);
+            }
+
+            Operand ReadLocal(runtime::Symbol name) {
+                Operand reg = locals_.at(name);
+                if (!assigned_[reg]) {
+                    Emit(OpCode::CheckBound, reg, Name(name));
+                }
+                return reg;
+            }
+
+            // Вычисляет выражение в регистр target, либо в новый временный регистр
+            Operand CompileExpressionTo(const ast::Statement& node, std::optional<Operand> target) {
+                auto dst = [&target, this]() {
+                    if (!target) {
+                        target = AllocTemp();
+                    }
+                    return *target;
+                };
+
+                if (auto p = dynamic_cast<const ast::NumericConst*>(&node)) {
+                    Emit(OpCode::LoadConst, dst(), Constant(runtime::ObjectHolder::Own(runtime::Number(p->GetValue()))));
+                }
+                else if (auto p = dynamic_cast<const ast::StringConst*>(&node)) {
+                    Emit(OpCode::LoadConst, dst(), Constant(runtime::ObjectHolder::Own(runtime::String(p->GetValue()))));
+                }
+                else if (auto p = dynamic_cast<const ast::BoolConst*>(&node)) {
+                    Emit(OpCode::LoadConst, dst(), Constant(runtime::ObjectHolder::Own(runtime::Bool(p->GetValue()))));
+                }
+                else if (dynamic_cast<const ast::None*>(&node)) {
+                    Emit(OpCode::LoadNone, dst());
+                }
+                else if (auto p = dynamic_cast<const ast::VariableValue*>(&node)) {
+                    Operand reg = ReadLocal(p->GetName());
+                    if (p->GetDottedIds().empty()) {
+                        Emit(OpCode::Move, dst(), reg);
+                    }
+                    else {
+                        for (runtime::Symbol field : p->GetDottedIds()) {
+                            Emit(OpCode::GetField, dst(), reg, Name(field), NewFieldCache());
+                            reg = *target;
+                        }
+                    }
+                }
+                else if (auto p = dynamic_cast<const ast::Assignment*>(&node)) {
+                    Operand reg = locals_.at(p->GetVarName());
+                    // Новый объект нельзя сразу связывать с переменной: аргументы __init__
+                    // могут ссылаться на её прежнее значение
+                    if (dynamic_cast<const ast::NewInstance*>(&p->GetRValue())) {
+                        Emit(OpCode::Move, reg, CompileExpression(p->GetRValue()));
+                    }
+                    else {
+                        CompileExpressionTo(p->GetRValue(), reg);
+                    }
+                    assigned_[reg] = true;
+                    if (target) {
+                        Emit(OpCode::Move, *target, reg);
+                    }
+                    return target ? *target : reg;
+                }
+                else if (auto p = dynamic_cast<const ast::FieldAssignment*>(&node)) {
+                    Operand object = CompileExpression(p->GetObject());
+                    Operand value = target ? CompileExpressionTo(p->GetRValue(), target)
+                                           : CompileExpression(p->GetRValue());
+                    Emit(OpCode::SetField, object, Name(p->GetFieldName()), value, NewFieldCache());
+                    return value;
+                }
+                else if (auto p = dynamic_cast<const ast::MethodCall*>(&node)) {
+                    CompileCall(*p, dst());
+                }
+                else if (auto p = dynamic_cast<const ast::NewInstance*>(&node)) {
+                    CompileNewInstance(*p, dst());
+                }
+                else if (auto p = dynamic_cast<const ast::Stringify*>(&node)) {
+                    Operand arg = CompileExpression(p->GetArgument());
+                    Emit(OpCode::Stringify, dst(), arg);
+                }
+                else if (auto p = dynamic_cast<const ast::Not*>(&node)) {
+                    Operand arg = CompileExpression(p->GetArgument());
+                    Emit(OpCode::Not, dst(), arg);
+                }
+                else if (auto p = dynamic_cast<const ast::BinaryOperation*>(&node)) {
+                    CompileChain(*p, dst());
+                }
+                else if (dynamic_cast<const ast::Print*>(&node)
+                    || dynamic_cast<const ast::IfElse*>(&node)
+                    || dynamic_cast<const ast::ClassDefinition*>(&node)
+                    || dynamic_cast<const ast::Compound*>(&node)
+                    || dynamic_cast<const ast::Return*>(&node)) {
+                    // Инструкции, не имеющие значения, возвращают None
+                    CompileStatement(node);
+                    Emit(OpCode::LoadNone, dst());
+                }
+                else {
+                    throw CompileError("Unsupported statement "s + typeid(node).name());
+                }
+                return *target;
+            }
+
+            // Возвращает узлы левой ветви цепочки операций, начиная с node
+            static vector<const ast::BinaryOperation*> LeftChain(const ast::BinaryOperation& node) {
+                vector<const ast::BinaryOperation*> chain{ &node };
+                while (auto p = dynamic_cast<const ast::BinaryOperation*>(&chain.back()->GetLhs())) {
+                    chain.push_back(p);
+                }
+                return chain;
+            }
+
+            // Цепочка операций a + b + c + ... компилируется циклом по левой ветви снизу вверх.
+            // Промежуточные результаты цепочки хранятся в одном временном регистре
+            void CompileChain(const ast::BinaryOperation& node, Operand dst) {
+                const vector<const ast::BinaryOperation*> chain = LeftChain(node);
+                Operand lhs = CompileExpression(chain.back()->GetLhs());
+                const Operand accumulator = chain.size() > 1 ? AllocTemp() : dst;
+                for (size_t i = chain.size(); i-- > 0;) {
+                    const Operand result = i == 0 ? dst : accumulator;
+                    CompileOperation(*chain[i], lhs, result);
+                    lhs = result;
+                }
+            }
+
+            // Компилирует операцию node над уже вычисленным левым аргументом из регистра lhs
+            void CompileOperation(const ast::BinaryOperation& node, Operand lhs, Operand dst) {
+                if (dynamic_cast<const ast::Or*>(&node)) {
+                    CompileLogical(node, lhs, true, dst);
+                }
+                else if (dynamic_cast<const ast::And*>(&node)) {
+                    CompileLogical(node, lhs, false, dst);
+                }
+                else if (auto p = dynamic_cast<const ast::Comparison*>(&node)) {
+                    CompileBinary(ComparisonOpCode(*p), node, lhs, dst);
+                }
+                else if (dynamic_cast<const ast::Add*>(&node)) {
+                    CompileBinary(OpCode::Add, node, lhs, dst);
+                }
+                else if (dynamic_cast<const ast::Sub*>(&node)) {
+                    CompileBinary(OpCode::Sub, node, lhs, dst);
+                }
+                else if (dynamic_cast<const ast::Mult*>(&node)) {
+                    CompileBinary(OpCode::Mult, node, lhs, dst);
+                }
+                else if (dynamic_cast<const ast::Div*>(&node)) {
+                    CompileBinary(OpCode::Div, node, lhs, dst);
+                }
+                else {
+                    throw CompileError("Unsupported statement "s + typeid(node).name());
+                }
+            }
+
+            void CompileBinary(OpCode op, const ast::BinaryOperation& node, Operand lhs, Operand dst) {
+                Operand rhs = CompileExpression(node.GetRhs());
+                Emit(op, dst, lhs, rhs);
+            }
+
+            // or: правый аргумент вычисляется, только если левый равен False.
+            // and: правый аргумент вычисляется, только если левый равен True
+            void CompileLogical(const ast::BinaryOperation& node, Operand lhs, bool is_or, Operand dst) {
+                size_t short_circuit = Emit(OpCode::JumpIfBool, 0, lhs, is_or ? 1 : 0);
+
+                const vector<bool> assigned_before = assigned_;
+                Operand rhs = CompileExpression(node.GetRhs());
+                Emit(OpCode::AsBool, dst, rhs);
+                assigned_ = assigned_before;
+                size_t jump_to_end = Emit(OpCode::Jump);
+
+                PatchJump(short_circuit);
+                Emit(OpCode::LoadConst, dst, Constant(runtime::ObjectHolder::Own(runtime::Bool(is_or))));
+                PatchJump(jump_to_end);
+            }
+
+            // Аргументы вызова размещаются в последовательных временных регистрах
+            Operand CompileArgs(const std::vector<std::unique_ptr<ast::Statement>>& args) {
+                vector<Operand> arg_regs;
+                arg_regs.reserve(args.size());
+                for (size_t i = 0; i < args.size(); ++i) {
+                    arg_regs.push_back(AllocTemp());
+                }
+                for (size_t i = 0; i < args.size(); ++i) {
+                    CompileExpressionTo(*args[i], arg_regs[i]);
+                }
+                return arg_regs.empty() ? 0 : arg_regs.front();
+            }
+
+            void CompileCall(const ast::MethodCall& node, Operand dst) {
+                Operand object = CompileExpression(node.GetObject());
+                Operand site = CallSiteFor(node.GetMethodName(), node.GetArgs().size());
+                if (!node.GetArgs().empty()) {
+                    // Наличие метода проверяется до вычисления аргументов
+                    Emit(OpCode::CheckMethod, 0, object, site);
+                }
+                Operand args = CompileArgs(node.GetArgs());
+                Emit(OpCode::Call, dst, object, site, args);
+            }
+
+            void CompileNewInstance(const ast::NewInstance& node, Operand dst) {
+                const runtime::Class& cls = node.GetClass();
+                Emit(OpCode::NewInstance, dst,
+                    Constant(runtime::ObjectHolder::Share(const_cast<runtime::Class&>(cls))));
+
+                // Если подходящего __init__ нет, аргументы не вычисляются
+                const runtime::Method* init = cls.GetMethod(runtime::SpecialMethod::Init);
+                if (init != nullptr && init->formal_params.size() == node.GetArgs().size()) {
+                    Operand site = CallSiteFor(runtime::INIT_METHOD, node.GetArgs().size());
+                    Operand args = CompileArgs(node.GetArgs());
+                    Emit(OpCode::Call, AllocTemp(), dst, site, args);
+                }
+            }
+        };
+
+    }  // namespace
+
+    Program::Program(std::unique_ptr<Function> main)
+        : main_(move(main))
+    {
+    }
+
+    const Function& Program::GetMain() const {
+        return *main_;
+    }
+
+    void Program::SetMain(std::unique_ptr<Function> main) {
+        main_ = move(main);
+    }
+
+    const Function* Program::GetMethod(const runtime::Method& method) const {
+        auto it = methods_.find(&method);
+        if (it == methods_.end()) {
+            unique_ptr<Function> function;
+            try {
+                function = CompileMethod(method);
+            }
+            catch (const CompileError&) {
+                // Такой метод будет исполняться деревом
+            }
+            it = methods_.emplace(&method, move(function)).first;
+        }
+        return it->second.get();
+    }
+
+    std::unique_ptr<Program> Compile(const runtime::Executable& program) {
+        return make_unique<Program>(CompileMain(program));
+    }
+
+    std::unique_ptr<Function> CompileMain(const runtime::Executable& program) {
+        return Compiler("<main>"s).Compile(program);
+    }
+
+    std::unique_ptr<Function> CompileMethod(const runtime::Method& method) {
+        method.Load();
+        const auto* body = dynamic_cast<const ast::MethodBody*>(method.body.get());
+        if (body == nullptr) {
+            return nullptr;
+        }
+        return Compiler(method.name.Name(), method.formal_params).Compile(*body);
+    }
+
+}  // namespace bytecode
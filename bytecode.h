@@ -0,0 +1,127 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bytecode {
+
+    // Операнд инструкции: номер регистра, индекс константы, имени, точки вызова или адрес перехода
+    using Operand = std::uint32_t;
+
+    // Коды операций регистровой виртуальной машины.
+    // В комментариях A, B, C, D - операнды инструкции, R[x] - регистр x текущего кадра
+    enum class OpCode : std::uint8_t {
+        LoadConst,       // R[A] = constants[B]
+        LoadNone,        // R[A] = None
+        Move,            // R[A] = R[B]
+        CheckBound,      // Ошибка, если переменной R[A] ещё не присвоено значение. names[B] - имя переменной
+        GetField,        // R[A] = R[B].names[C], field_caches[D] - кэш доступа к полю
+        SetField,        // R[A].names[B] = R[C], field_caches[D] - кэш доступа к полю
+        Add,             // R[A] = R[B] + R[C]
+        Sub,             // R[A] = R[B] - R[C]
+        Mult,            // R[A] = R[B] * R[C]
+        Div,             // R[A] = R[B] / R[C]
+        Equal,           // R[A] = R[B] == R[C]
+        NotEqual,        // R[A] = R[B] != R[C]
+        Less,            // R[A] = R[B] < R[C]
+        Greater,         // R[A] = R[B] > R[C]
+        LessOrEqual,     // R[A] = R[B] <= R[C]
+        GreaterOrEqual,  // R[A] = R[B] >= R[C]
+        Not,             // R[A] = not R[B], R[B] обязан иметь тип Bool
+        AsBool,          // R[A] = R[B], R[B] обязан иметь тип Bool
+        Jump,            // Переход на инструкцию A
+        JumpIfFalse,     // Переход на инструкцию A, если R[B] приводится к False
+        JumpIfBool,      // Переход на инструкцию A, если R[B] (обязан иметь тип Bool) равен C
+        CheckMethod,     // Проверяет, что у объекта R[B] есть метод call_sites[C]
+        Call,            // R[A] = R[B].call_sites[C](R[D], R[D + 1], ...)
+        NewInstance,     // R[A] = новый экземпляр класса constants[B]
+        Stringify,       // R[A] = str(R[B])
+        PrintArg,        // Выводит R[B], предваряя его пробелом, если C != 0
+        PrintEnd,        // Завершает вывод команды print переводом строки
+        Return,          // Возвращает R[A] из текущей функции
+    };
+
+    // Инструкция фиксированного размера
+    struct Instruction {
+        OpCode op;
+        Operand a = 0;
+        Operand b = 0;
+        Operand c = 0;
+        Operand d = 0;
+    };
+
+    struct Function;
+
+    // Точка вызова метода. Помнит последний класс получателя и найденный для него метод,
+    // поэтому повторный вызов с тем же классом обходится без поиска по имени
+    struct CallSite {
+        runtime::Symbol method;
+        Operand argc = 0;
+        runtime::MethodId method_id = runtime::NO_METHOD_ID;
+
+        const runtime::Class* cls = nullptr;
+        const runtime::Method* resolved = nullptr;
+        // Скомпилированное тело метода или nullptr, если метод исполняется деревом
+        const Function* function = nullptr;
+    };
+
+    // Скомпилированное тело метода либо программы верхнего уровня.
+    // Регистры [0, locals.size()) закреплены за переменными: в методе регистр 0 - self,
+    // следом идут формальные параметры. Остальные регистры - временные
+    struct Function {
+        std::string name;
+        std::vector<Instruction> code;
+        std::vector<runtime::ObjectHolder> constants;
+        std::vector<runtime::Symbol> names;
+        std::vector<runtime::Symbol> locals;
+        // Точки вызова изменяются во время исполнения - в них хранится кэш разрешения методов
+        mutable std::vector<CallSite> call_sites;
+        mutable std::vector<runtime::FieldCache> field_caches;
+        // Количество регистров, связанных до начала исполнения (self и параметры)
+        Operand params = 0;
+        // Общее количество регистров кадра
+        Operand registers = 0;
+    };
+
+    class CompileError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Скомпилированная программа. Тела методов компилируются при первом обращении к ним
+    class Program {
+    public:
+        explicit Program(std::unique_ptr<Function> main);
+
+        [[nodiscard]] const Function& GetMain() const;
+
+        // Заменяет программу верхнего уровня. Скомпилированные тела методов сохраняются,
+        // поэтому программу можно исполнять по частям, не компилируя методы повторно
+        void SetMain(std::unique_ptr<Function> main);
+
+        // Возвращает скомпилированное тело метода либо nullptr, если тело метода не может быть
+        // скомпилировано (например, задано собственной реализацией runtime::Executable)
+        [[nodiscard]] const Function* GetMethod(const runtime::Method& method) const;
+
+    private:
+        std::unique_ptr<Function> main_;
+        mutable std::unordered_map<const runtime::Method*, std::unique_ptr<Function>> methods_;
+    };
+
+    // Компилирует дерево программы, построенное ParseProgram.
+    // Выбрасывает CompileError, если в дереве встретился неизвестный узел
+    [[nodiscard]] std::unique_ptr<Program> Compile(const runtime::Executable& program);
+
+    // Компилирует дерево program как программу верхнего уровня, не создавая для неё Program
+    [[nodiscard]] std::unique_ptr<Function> CompileMain(const runtime::Executable& program);
+
+    // Компилирует тело метода. Возвращает nullptr, если тело не является ast::MethodBody
+    [[nodiscard]] std::unique_ptr<Function> CompileMethod(const runtime::Method& method);
+
+}  // namespace bytecode
@@ -0,0 +1,677 @@
+#include "cache.h"
+
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unordered_map>
+
+using namespace std;
+
+namespace cache {
+
+    namespace {
+
+        // Первые байты файла кэша. Записываются в порядке байтов машины, поэтому кэш,
+        // перенесённый на машину с другим порядком байтов, не распознаётся
+        constexpr uint32_t MAGIC = 0x4d594331;
+        constexpr uint32_t NO_CLASS = UINT32_MAX;
+
+        using ComparatorFn = bool (*)(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+            runtime::Context&);
+
+        // Функции сравнения узлов ast::Comparison сохраняются номерами в этом массиве
+        const array<ComparatorFn, 6> COMPARATORS = {
+            runtime::Equal, runtime::NotEqual, runtime::Less,
+            runtime::Greater, runtime::LessOrEqual, runtime::GreaterOrEqual,
+        };
+
+        // Вид узла дерева
+        enum class Node : uint8_t {
+            Null,  // отсутствующая ветка else
+            NumericConst,
+            StringConst,
+            BoolConst,
+            None,
+            VariableValue,
+            Assignment,
+            FieldAssignment,
+            Print,
+            MethodCall,
+            NewInstance,
+            Stringify,
+            Add,
+            Sub,
+            Mult,
+            Div,
+            Or,
+            And,
+            Not,
+            Compound,
+            MethodBody,
+            Return,
+            ClassDefinition,
+            IfElse,
+            Comparison,
+        };
+
+        // Заголовок файла кэша, за которым следуют payload_size байт: таблица символов
+        // и дерево программы
+        struct Header {
+            uint32_t magic = MAGIC;
+            uint32_t version = FORMAT_VERSION;
+            uint64_t source_size = 0;
+            uint64_t source_hash = 0;
+            uint64_t payload_size = 0;
+            uint64_t payload_hash = 0;
+        };
+
+        // Дерево нельзя сохранить или данные кэша повреждены
+        struct CacheError : runtime_error {
+            using runtime_error::runtime_error;
+        };
+
+        // FNV-1a
+        uint64_t Hash(string_view data) {
+            uint64_t hash = 14695981039346656037ull;
+            for (char c : data) {
+                hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            }
+            return hash;
+        }
+
+        class Writer {
+        public:
+            void WriteNode(const ast::Statement* node) {
+                if (node == nullptr) {
+                    WriteKind(Node::Null);
+                }
+                else if (auto p = dynamic_cast<const ast::NumericConst*>(node)) {
+                    WriteKind(Node::NumericConst);
+                    WriteValue(p->GetValue().GetValue());
+                }
+                else if (auto p = dynamic_cast<const ast::StringConst*>(node)) {
+                    WriteKind(Node::StringConst);
+                    WriteString(p->GetValue().GetValue());
+                }
+                else if (auto p = dynamic_cast<const ast::BoolConst*>(node)) {
+                    WriteKind(Node::BoolConst);
+                    WriteValue<uint8_t>(p->GetValue().GetValue());
+                }
+                else if (dynamic_cast<const ast::None*>(node)) {
+                    WriteKind(Node::None);
+                }
+                else if (auto p = dynamic_cast<const ast::VariableValue*>(node)) {
+                    WriteKind(Node::VariableValue);
+                    WriteVariable(*p);
+                }
+                else if (auto p = dynamic_cast<const ast::Assignment*>(node)) {
+                    WriteKind(Node::Assignment);
+                    WriteSymbol(p->GetVarName());
+                    WriteValue<uint64_t>(p->GetSlot());
+                    WriteNode(&p->GetRValue());
+                }
+                else if (auto p = dynamic_cast<const ast::FieldAssignment*>(node)) {
+                    WriteKind(Node::FieldAssignment);
+                    WriteVariable(p->GetObject());
+                    WriteSymbol(p->GetFieldName());
+                    WriteNode(&p->GetRValue());
+                }
+                else if (auto p = dynamic_cast<const ast::Print*>(node)) {
+                    WriteKind(Node::Print);
+                    WriteNodes(p->GetArgs());
+                }
+                else if (auto p = dynamic_cast<const ast::MethodCall*>(node)) {
+                    WriteKind(Node::MethodCall);
+                    WriteNode(&p->GetObject());
+                    WriteSymbol(p->GetMethodName());
+                    WriteNodes(p->GetArgs());
+                }
+                else if (auto p = dynamic_cast<const ast::NewInstance*>(node)) {
+                    WriteKind(Node::NewInstance);
+                    WriteValue(ClassId(&p->GetClass()));
+                    WriteNodes(p->GetArgs());
+                }
+                else if (auto p = dynamic_cast<const ast::Stringify*>(node)) {
+                    WriteKind(Node::Stringify);
+                    WriteNode(&p->GetArgument());
+                }
+                else if (auto p = dynamic_cast<const ast::Not*>(node)) {
+                    WriteKind(Node::Not);
+                    WriteNode(&p->GetArgument());
+                }
+                else if (auto p = dynamic_cast<const ast::BinaryOperation*>(node)) {
+                    WriteChain(*p);
+                }
+                else if (auto p = dynamic_cast<const ast::Compound*>(node)) {
+                    WriteKind(Node::Compound);
+                    WriteNodes(p->GetStatements());
+                }
+                else if (auto p = dynamic_cast<const ast::MethodBody*>(node)) {
+                    WriteKind(Node::MethodBody);
+                    WriteNode(&p->GetBody());
+                }
+                else if (auto p = dynamic_cast<const ast::Return*>(node)) {
+                    WriteKind(Node::Return);
+                    WriteNode(&p->GetStatement());
+                }
+                else if (auto p = dynamic_cast<const ast::ClassDefinition*>(node)) {
+                    WriteKind(Node::ClassDefinition);
+                    WriteClass(*p->GetClass().TryAs<runtime::Class>());
+                }
+                else if (auto p = dynamic_cast<const ast::IfElse*>(node)) {
+                    WriteKind(Node::IfElse);
+                    WriteNode(&p->GetCondition());
+                    WriteNode(&p->GetIfBody());
+                    WriteNode(p->GetElseBody());
+                }
+                else {
+                    throw CacheError("Unsupported node"s);
+                }
+            }
+
+            // Возвращает файл кэша: заголовок, таблицу символов и записанное дерево
+            string Finish(string_view source) {
+                string payload;
+                swap(payload, data_);
+                WriteValue(static_cast<uint32_t>(symbols_.size()));
+                for (runtime::Symbol symbol : symbols_) {
+                    WriteString(symbol.Name());
+                }
+                payload.insert(0, data_);
+
+                Header header;
+                header.source_size = source.size();
+                header.source_hash = Hash(source);
+                header.payload_size = payload.size();
+                header.payload_hash = Hash(payload);
+
+                string result(sizeof(header), '\0');
+                memcpy(result.data(), &header, sizeof(header));
+                result += payload;
+                return result;
+            }
+
+        private:
+            string data_;
+            unordered_map<runtime::Symbol, uint32_t> symbol_ids_;
+            vector<runtime::Symbol> symbols_;
+            // Номера классов, объявленных в уже записанной части дерева
+            unordered_map<const runtime::Class*, uint32_t> class_ids_;
+
+            template <typename T>
+            void WriteValue(T value) {
+                char bytes[sizeof(T)];
+                memcpy(bytes, &value, sizeof(T));
+                data_.append(bytes, sizeof(T));
+            }
+
+            void WriteKind(Node kind) {
+                WriteValue(static_cast<uint8_t>(kind));
+            }
+
+            void WriteString(string_view str) {
+                WriteValue(static_cast<uint32_t>(str.size()));
+                data_ += str;
+            }
+
+            void WriteSymbol(runtime::Symbol symbol) {
+                auto [it, inserted] = symbol_ids_.emplace(symbol, static_cast<uint32_t>(symbols_.size()));
+                if (inserted) {
+                    symbols_.push_back(symbol);
+                }
+                WriteValue(it->second);
+            }
+
+            void WriteSymbols(const vector<runtime::Symbol>& symbols) {
+                WriteValue(static_cast<uint32_t>(symbols.size()));
+                for (runtime::Symbol symbol : symbols) {
+                    WriteSymbol(symbol);
+                }
+            }
+
+            void WriteNodes(const vector<unique_ptr<ast::Statement>>& nodes) {
+                WriteValue(static_cast<uint32_t>(nodes.size()));
+                for (const auto& node : nodes) {
+                    WriteNode(node.get());
+                }
+            }
+
+            // Вид узла операции записывается перед её аргументами, номер функции сравнения - после.
+            // Цепочка a + b + c + ... записывается циклом по левой ветви: виды её узлов сверху вниз,
+            // нижний левый аргумент, затем правые аргументы снизу вверх
+            void WriteChain(const ast::BinaryOperation& node) {
+                vector<const ast::BinaryOperation*> chain{ &node };
+                while (auto p = dynamic_cast<const ast::BinaryOperation*>(&chain.back()->GetLhs())) {
+                    chain.push_back(p);
+                }
+                for (const ast::BinaryOperation* p : chain) {
+                    WriteKind(BinaryKind(*p));
+                }
+                WriteNode(&chain.back()->GetLhs());
+                for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                    WriteNode(&(*it)->GetRhs());
+                    if (auto p = dynamic_cast<const ast::Comparison*>(*it)) {
+                        WriteValue(ComparatorIndex(*p));
+                    }
+                }
+            }
+
+            static Node BinaryKind(const ast::BinaryOperation& node) {
+                if (dynamic_cast<const ast::Add*>(&node)) {
+                    return Node::Add;
+                }
+                if (dynamic_cast<const ast::Sub*>(&node)) {
+                    return Node::Sub;
+                }
+                if (dynamic_cast<const ast::Mult*>(&node)) {
+                    return Node::Mult;
+                }
+                if (dynamic_cast<const ast::Div*>(&node)) {
+                    return Node::Div;
+                }
+                if (dynamic_cast<const ast::Or*>(&node)) {
+                    return Node::Or;
+                }
+                if (dynamic_cast<const ast::And*>(&node)) {
+                    return Node::And;
+                }
+                if (auto p = dynamic_cast<const ast::Comparison*>(&node)) {
+                    ComparatorIndex(*p);
+                    return Node::Comparison;
+                }
+                throw CacheError("Unsupported node"s);
+            }
+
+            static uint8_t ComparatorIndex(const ast::Comparison& node) {
+                const ComparatorFn* fn = node.GetComparator().target<ComparatorFn>();
+                auto it = fn == nullptr ? COMPARATORS.end() : find(COMPARATORS.begin(), COMPARATORS.end(), *fn);
+                if (it == COMPARATORS.end()) {
+                    throw CacheError("Unsupported comparator"s);
+                }
+                return static_cast<uint8_t>(it - COMPARATORS.begin());
+            }
+
+            void WriteVariable(const ast::VariableValue& node) {
+                WriteSymbol(node.GetName());
+                WriteSymbols(node.GetDottedIds());
+                WriteValue<uint64_t>(node.GetSlot());
+            }
+
+            uint32_t ClassId(const runtime::Class* cls) {
+                if (cls == nullptr) {
+                    return NO_CLASS;
+                }
+                // Классы, объявленные вне дерева, нельзя восстановить при загрузке
+                auto it = class_ids_.find(cls);
+                if (it == class_ids_.end()) {
+                    throw CacheError("Class "s + cls->GetName() + " is declared outside of the program"s);
+                }
+                return it->second;
+            }
+
+            void WriteClass(const runtime::Class& cls) {
+                WriteSymbol(cls.GetName());
+                WriteValue(ClassId(cls.GetParent()));
+                WriteValue(static_cast<uint32_t>(cls.GetMethods().size()));
+                for (const runtime::Method& method : cls.GetMethods()) {
+                    // В кэш записываются разобранные тела, поэтому отложенный разбор выполняется сейчас
+                    method.Load();
+                    WriteSymbol(method.name);
+                    WriteSymbols(method.formal_params);
+                    WriteValue<uint64_t>(method.frame_size);
+                    WriteNode(method.body.get());
+                }
+                // Класс получает номер после методов: при загрузке он создаётся из уже прочитанных методов
+                class_ids_.emplace(&cls, static_cast<uint32_t>(class_ids_.size()));
+            }
+        };
+
+        class Reader {
+        public:
+            Reader(string_view data, size_t max_depth)
+                : data_(data)
+                , max_depth_(max_depth)
+            {
+            }
+
+            void ReadSymbolTable() {
+                const uint32_t count = ReadValue<uint32_t>();
+                symbols_.reserve(min<size_t>(count, data_.size()));
+                for (uint32_t i = 0; i < count; ++i) {
+                    symbols_.emplace_back(ReadString());
+                }
+            }
+
+            // Читает узел с поддеревом. Чтение рекурсивно, поэтому глубина дерева ограничена так же,
+            // как при разборе: повреждённый файл с верной контрольной суммой не переполнит стек
+            unique_ptr<ast::Statement> ReadNode() {
+                if (++depth_ > max_depth_ * NODES_PER_LEVEL) {
+                    throw CacheError("Nesting depth exceeds the limit"s);
+                }
+                unique_ptr<ast::Statement> result = ReadNodeOfKind(static_cast<Node>(ReadValue<uint8_t>()));
+                --depth_;
+                return result;
+            }
+
+            [[nodiscard]] bool AtEnd() const {
+                return data_.empty();
+            }
+
+        private:
+            // Наибольшее число вложенных узлов на один уровень вложенности разбора: например,
+            // Compound -> IfElse -> Compound для блока или Print -> Add -> MethodCall для аргументов
+            static constexpr size_t NODES_PER_LEVEL = 4;
+
+            string_view data_;
+            size_t max_depth_;
+            size_t depth_ = 0;
+            vector<runtime::Symbol> symbols_;
+            vector<runtime::ObjectHolder> classes_;
+
+            unique_ptr<ast::Statement> ReadNodeOfKind(Node kind) {
+                switch (kind) {
+                case Node::Null:
+                    return nullptr;
+                case Node::NumericConst:
+                    return make_unique<ast::NumericConst>(ReadValue<int64_t>());
+                case Node::StringConst:
+                    return make_unique<ast::StringConst>(string(ReadString()));
+                case Node::BoolConst:
+                    return make_unique<ast::BoolConst>(ReadValue<uint8_t>() != 0);
+                case Node::None:
+                    return make_unique<ast::None>();
+                case Node::VariableValue:
+                    return ReadVariable();
+                case Node::Assignment: {
+                    runtime::Symbol name = ReadSymbol();
+                    const auto slot = static_cast<size_t>(ReadValue<uint64_t>());
+                    return make_unique<ast::Assignment>(name, ReadRequiredNode(), slot);
+                }
+                case Node::FieldAssignment: {
+                    unique_ptr<ast::VariableValue> object = ReadVariable();
+                    runtime::Symbol field = ReadSymbol();
+                    return make_unique<ast::FieldAssignment>(move(*object), field, ReadRequiredNode());
+                }
+                case Node::Print:
+                    return make_unique<ast::Print>(ReadNodes());
+                case Node::MethodCall: {
+                    unique_ptr<ast::Statement> object = ReadRequiredNode();
+                    runtime::Symbol method = ReadSymbol();
+                    return make_unique<ast::MethodCall>(move(object), method, ReadNodes());
+                }
+                case Node::NewInstance: {
+                    const runtime::Class* cls = ReadClassId();
+                    if (cls == nullptr) {
+                        throw CacheError("Missing class"s);
+                    }
+                    return make_unique<ast::NewInstance>(*cls, ReadNodes());
+                }
+                case Node::Stringify:
+                    return make_unique<ast::Stringify>(ReadRequiredNode());
+                case Node::Not:
+                    return make_unique<ast::Not>(ReadRequiredNode());
+                case Node::Add:
+                case Node::Sub:
+                case Node::Mult:
+                case Node::Div:
+                case Node::Or:
+                case Node::And:
+                case Node::Comparison:
+                    return ReadChain(kind);
+                case Node::Compound: {
+                    auto result = make_unique<ast::Compound>();
+                    for (auto& statement : ReadNodes()) {
+                        result->AddStatement(move(statement));
+                    }
+                    return result;
+                }
+                case Node::MethodBody:
+                    return make_unique<ast::MethodBody>(ReadRequiredNode());
+                case Node::Return:
+                    return make_unique<ast::Return>(ReadRequiredNode());
+                case Node::ClassDefinition:
+                    return make_unique<ast::ClassDefinition>(ReadClass());
+                case Node::IfElse: {
+                    unique_ptr<ast::Statement> condition = ReadRequiredNode();
+                    unique_ptr<ast::Statement> if_body = ReadRequiredNode();
+                    return make_unique<ast::IfElse>(move(condition), move(if_body), ReadNode());
+                }
+                }
+                throw CacheError("Bad node"s);
+            }
+
+            string_view ReadBytes(size_t size) {
+                if (size > data_.size()) {
+                    throw CacheError("Unexpected end of cache"s);
+                }
+                string_view result = data_.substr(0, size);
+                data_.remove_prefix(size);
+                return result;
+            }
+
+            template <typename T>
+            T ReadValue() {
+                T value;
+                memcpy(&value, ReadBytes(sizeof(T)).data(), sizeof(T));
+                return value;
+            }
+
+            string_view ReadString() {
+                return ReadBytes(ReadValue<uint32_t>());
+            }
+
+            runtime::Symbol ReadSymbol() {
+                const uint32_t id = ReadValue<uint32_t>();
+                if (id >= symbols_.size()) {
+                    throw CacheError("Bad symbol"s);
+                }
+                return symbols_[id];
+            }
+
+            vector<runtime::Symbol> ReadSymbols() {
+                vector<runtime::Symbol> result(ReadValue<uint32_t>());
+                for (runtime::Symbol& symbol : result) {
+                    symbol = ReadSymbol();
+                }
+                return result;
+            }
+
+            unique_ptr<ast::Statement> ReadRequiredNode() {
+                unique_ptr<ast::Statement> result = ReadNode();
+                if (!result) {
+                    throw CacheError("Missing node"s);
+                }
+                return result;
+            }
+
+            vector<unique_ptr<ast::Statement>> ReadNodes() {
+                vector<unique_ptr<ast::Statement>> result(ReadValue<uint32_t>());
+                for (auto& node : result) {
+                    node = ReadRequiredNode();
+                }
+                return result;
+            }
+
+            static bool IsBinary(Node kind) {
+                switch (kind) {
+                case Node::Add:
+                case Node::Sub:
+                case Node::Mult:
+                case Node::Div:
+                case Node::Or:
+                case Node::And:
+                case Node::Comparison:
+                    return true;
+                default:
+                    return false;
+                }
+            }
+
+            // Читает цепочку операций, записанную Writer::WriteChain, вид верхнего узла которой kind
+            unique_ptr<ast::Statement> ReadChain(Node kind) {
+                vector<Node> chain{ kind };
+                while (!data_.empty() && IsBinary(static_cast<Node>(data_.front()))) {
+                    chain.push_back(static_cast<Node>(ReadValue<uint8_t>()));
+                }
+                unique_ptr<ast::Statement> result = ReadRequiredNode();
+                for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                    unique_ptr<ast::Statement> rhs = ReadRequiredNode();
+                    result = MakeBinary(*it, move(result), move(rhs));
+                }
+                return result;
+            }
+
+            unique_ptr<ast::Statement> MakeBinary(Node kind, unique_ptr<ast::Statement> lhs,
+                unique_ptr<ast::Statement> rhs) {
+                switch (kind) {
+                case Node::Add:
+                    return make_unique<ast::Add>(move(lhs), move(rhs));
+                case Node::Sub:
+                    return make_unique<ast::Sub>(move(lhs), move(rhs));
+                case Node::Mult:
+                    return make_unique<ast::Mult>(move(lhs), move(rhs));
+                case Node::Div:
+                    return make_unique<ast::Div>(move(lhs), move(rhs));
+                case Node::Or:
+                    return make_unique<ast::Or>(move(lhs), move(rhs));
+                case Node::And:
+                    return make_unique<ast::And>(move(lhs), move(rhs));
+                default: {
+                    const uint8_t cmp = ReadValue<uint8_t>();
+                    if (cmp >= COMPARATORS.size()) {
+                        throw CacheError("Bad comparator"s);
+                    }
+                    return make_unique<ast::Comparison>(COMPARATORS[cmp], move(lhs), move(rhs));
+                }
+                }
+            }
+
+            unique_ptr<ast::VariableValue> ReadVariable() {
+                vector<runtime::Symbol> ids(1, ReadSymbol());
+                for (runtime::Symbol id : ReadSymbols()) {
+                    ids.push_back(id);
+                }
+                const auto slot = static_cast<size_t>(ReadValue<uint64_t>());
+                return make_unique<ast::VariableValue>(move(ids), slot);
+            }
+
+            const runtime::Class* ReadClassId() {
+                const uint32_t id = ReadValue<uint32_t>();
+                if (id == NO_CLASS) {
+                    return nullptr;
+                }
+                if (id >= classes_.size()) {
+                    throw CacheError("Bad class"s);
+                }
+                return classes_[id].TryAs<runtime::Class>();
+            }
+
+            runtime::ObjectHolder ReadClass() {
+                runtime::Symbol name = ReadSymbol();
+                const runtime::Class* parent = ReadClassId();
+                vector<runtime::Method> methods(ReadValue<uint32_t>());
+                for (runtime::Method& method : methods) {
+                    method.name = ReadSymbol();
+                    method.id = runtime::InternMethodName(method.name);
+                    method.formal_params = ReadSymbols();
+                    method.frame_size = static_cast<size_t>(ReadValue<uint64_t>());
+                    method.body = ReadRequiredNode();
+                }
+                return classes_.emplace_back(runtime::ObjectHolder::Own(runtime::Class(name, move(methods), parent)));
+            }
+        };
+
+    }  // namespace
+
+    optional<string> SaveProgram(const runtime::Executable& program, string_view source) {
+        try {
+            Writer writer;
+            writer.WriteNode(&program);
+            return writer.Finish(source);
+        }
+        catch (const CacheError&) {
+            return nullopt;
+        }
+    }
+
+    unique_ptr<runtime::Executable> LoadProgram(string_view data, string_view source,
+        const ParseOptions& options) {
+        Header header;
+        if (data.size() < sizeof(header)) {
+            return nullptr;
+        }
+        memcpy(&header, data.data(), sizeof(header));
+        data.remove_prefix(sizeof(header));
+        if (header.magic != MAGIC || header.version != FORMAT_VERSION
+            || header.payload_size != data.size() || header.payload_hash != Hash(data)
+            || header.source_size != source.size() || header.source_hash != Hash(source)) {
+            return nullptr;
+        }
+
+        try {
+            Reader reader(data, options.max_depth);
+            reader.ReadSymbolTable();
+            unique_ptr<runtime::Executable> program = reader.ReadNode();
+            return reader.AtEnd() ? move(program) : nullptr;
+        }
+        catch (const CacheError&) {
+            return nullptr;
+        }
+    }
+
+    string GetCachePath(const string& script_path, const string& cache_dir) {
+        if (cache_dir.empty()) {
+            return script_path + ".myc"s;
+        }
+        // Одноимённые программы из разных каталогов различаются хешем полного пути
+        error_code error;
+        filesystem::path path = filesystem::absolute(script_path, error);
+        if (error) {
+            path = script_path;
+        }
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(Hash(path.string())));
+        return (filesystem::path(cache_dir) / (path.filename().string() + '-' + hash + ".myc"s)).string();
+    }
+
+    unique_ptr<runtime::Executable> ParseCached(string_view source, const string& cache_path,
+        const ParseOptions& options) {
+        try {
+            parse::SourceFile cached(cache_path);
+            if (auto program = LoadProgram(cached.GetText(), source, options)) {
+                return program;
+            }
+        }
+        catch (const parse::LexerError&) {
+            // Кэша ещё нет
+        }
+
+        parse::Lexer lexer(parse::TokenizeParallel(source));
+        unique_ptr<runtime::Executable> program = ParseProgram(lexer, options);
+
+        if (optional<string> data = SaveProgram(*program, source)) {
+            // Кэш записывается во временный файл и переименовывается, поэтому одновременно
+            // запущенные программы не увидят его записанным частично
+            const string temp_path = cache_path + '.' + to_string(random_device{}()) + ".tmp"s;
+            ofstream out(temp_path, ios::binary);
+            out.write(data->data(), static_cast<streamsize>(data->size()));
+            out.close();
+            error_code error;
+            if (out) {
+                filesystem::rename(temp_path, cache_path, error);
+            }
+            if (!out || error) {
+                filesystem::remove(temp_path, error);
+            }
+        }
+        return program;
+    }
+
+}  // namespace cache
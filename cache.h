@@ -0,0 +1,38 @@
+#pragma once
+
+#include "parse.h"
+#include "runtime.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace cache {
+
+    // Версия формата кэша. Увеличивается при любом изменении формата или узлов дерева
+    constexpr std::uint32_t FORMAT_VERSION = 1;
+
+    // Сохраняет программу program, разобранную из текста source: объявленные классы с телами
+    // методов и дерево инструкций верхнего уровня. Возвращает std::nullopt, если в дереве
+    // встретился узел, который не сохраняется в кэше
+    [[nodiscard]] std::optional<std::string> SaveProgram(const runtime::Executable& program,
+        std::string_view source);
+
+    // Восстанавливает программу из data. Возвращает nullptr, если data сохранены для другого текста,
+    // другой версией формата, повреждены или вложенность дерева превышает options.max_depth
+    [[nodiscard]] std::unique_ptr<runtime::Executable> LoadProgram(std::string_view data,
+        std::string_view source, const ParseOptions& options = {});
+
+    // Возвращает путь файла кэша для программы из файла script_path. Если cache_dir пуст,
+    // кэш лежит рядом с программой
+    [[nodiscard]] std::string GetCachePath(const std::string& script_path, const std::string& cache_dir);
+
+    // Возвращает программу из кэша cache_path, если кэш соответствует тексту source. Иначе разбирает
+    // source с параметрами options и перезаписывает кэш. Ошибки чтения и записи кэша не влияют
+    // на результат
+    [[nodiscard]] std::unique_ptr<runtime::Executable> ParseCached(std::string_view source,
+        const std::string& cache_path, const ParseOptions& options = {});
+
+}  // namespace cache
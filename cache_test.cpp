@@ -0,0 +1,202 @@
+#include "cache.h"
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+#include "test_runner_p.h"
+#include "vm.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+using namespace std;
+
+namespace cache {
+
+namespace {
+
+const string PROGRAM = R"(
+class Shape:
+  def __init__(name):
+    self.name = name
+
+  def __str__():
+    return 'Shape ' + self.name
+
+  def area():
+    return 0
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.name = "rect"
+    self.w = w
+    self.h = h
+
+  def area():
+    s = self.w * self.h
+    return s
+
+  def __lt__(other):
+    return self.area() < other.area()
+
+r = Rect(3, 4)
+q = Rect(2, 2)
+print r, r.area(), q < r, r.w >= 3 and not False, None
+if r.area() - 12 == 0 or q.area() / 0 > 1:
+  print 'ok', str(-1)
+else:
+  print "no"
+r.w = 10
+print r.area(), True != False, q <= r, q > r, q.name != 'rect'
+)"s;
+
+unique_ptr<runtime::Executable> Parse(string_view source) {
+    parse::Lexer lexer(source);
+    return ParseProgram(lexer);
+}
+
+string Run(runtime::Executable& program, bool use_vm) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    if (use_vm) {
+        vm::Execute(program, closure, context);
+    } else {
+        program.Execute(closure, context);
+    }
+    return context.output.str();
+}
+
+void TestRoundTrip() {
+    auto parsed = Parse(PROGRAM);
+    optional<string> data = SaveProgram(*parsed, PROGRAM);
+    ASSERT(data.has_value());
+
+    auto loaded = LoadProgram(*data, PROGRAM);
+    ASSERT(loaded != nullptr);
+    ASSERT_EQUAL(Run(*loaded, false), Run(*parsed, false));
+    ASSERT_EQUAL(Run(*loaded, true), Run(*parsed, true));
+
+    // Загруженная программа сохраняется в те же байты
+    ASSERT_EQUAL(*SaveProgram(*loaded, PROGRAM), *data);
+}
+
+void TestLongChains() {
+    // Цепочки операций сохраняются и загружаются без рекурсии
+    string program = "x = 1\nprint 0"s;
+    for (int i = 0; i < 5000; ++i) {
+        program += i % 2 ? " + x"s : " - 2 * x"s;
+    }
+    program += " < 0\n"s;
+
+    auto parsed = Parse(program);
+    optional<string> data = SaveProgram(*parsed, program);
+    ASSERT(data.has_value());
+
+    auto loaded = LoadProgram(*data, program);
+    ASSERT(loaded != nullptr);
+    ASSERT_EQUAL(Run(*loaded, false), "True\n"s);
+    ASSERT_EQUAL(*SaveProgram(*loaded, program), *data);
+}
+
+void TestRejectsStaleAndCorruptData() {
+    auto parsed = Parse(PROGRAM);
+    const string data = *SaveProgram(*parsed, PROGRAM);
+
+    // Кэш другого текста
+    ASSERT(LoadProgram(data, PROGRAM + "\n"s) == nullptr);
+    ASSERT(LoadProgram(data, "print 1\n"sv) == nullptr);
+
+    // Повреждённый заголовок, дерево или обрезанный файл
+    for (size_t pos : {size_t{0}, size_t{4}, data.size() / 2, data.size() - 1}) {
+        string corrupt = data;
+        corrupt[pos] = static_cast<char>(corrupt[pos] ^ 0x5a);
+        ASSERT(LoadProgram(corrupt, PROGRAM) == nullptr);
+    }
+    ASSERT(LoadProgram(string_view(data).substr(0, data.size() - 1), PROGRAM) == nullptr);
+    ASSERT(LoadProgram(""sv, PROGRAM) == nullptr);
+}
+
+void TestNestingLimit() {
+    // Программа на пределе вложенности разбора загружается с тем же пределом
+    ParseOptions options;
+    options.max_depth = 20;
+    string nested;
+    for (size_t i = 0; i < options.max_depth; ++i) {
+        nested += string(4 * i, ' ') + "class C"s + to_string(i) + ":\n"s
+            + string(4 * i + 2, ' ') + "def m():\n"s;
+    }
+    nested += string(4 * options.max_depth, ' ') + "return 1\n"s;
+    {
+        parse::Lexer lexer(nested);
+        auto parsed = ParseProgram(lexer, options);
+        optional<string> data = SaveProgram(*parsed, nested);
+        ASSERT(data.has_value());
+        ASSERT(LoadProgram(*data, nested, options) != nullptr);
+    }
+
+    // Цепочка not глубже предела отклоняется, а не переполняет стек, хотя контрольная сумма верна
+    string deep = "print "s;
+    for (int i = 0; i < 500; ++i) {
+        deep += "not "s;
+    }
+    deep += "1\n"s;
+    optional<string> data = SaveProgram(*Parse(deep), deep);
+    ASSERT(data.has_value());
+    ASSERT(LoadProgram(*data, deep) != nullptr);
+    options.max_depth = 100;
+    ASSERT(LoadProgram(*data, deep, options) == nullptr);
+}
+
+void TestParseCached() {
+    const filesystem::path dir = filesystem::temp_directory_path() / "mython_cache_test";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    const string script = (dir / "script.my").string();
+
+    const string cache_path = GetCachePath(script, dir.string());
+    ASSERT(cache_path != GetCachePath(script, ""s));
+    ASSERT(!filesystem::exists(cache_path));
+
+    // Первый запуск разбирает программу и записывает кэш
+    auto first = ParseCached(PROGRAM, cache_path);
+    ASSERT(filesystem::exists(cache_path));
+    ASSERT_EQUAL(Run(*first, false), Run(*Parse(PROGRAM), false));
+
+    // Кэш соответствует тексту
+    {
+        ifstream in(cache_path, ios::binary);
+        const string data(istreambuf_iterator<char>(in), istreambuf_iterator<char>{});
+        ASSERT(LoadProgram(data, PROGRAM) != nullptr);
+    }
+    ASSERT_EQUAL(Run(*ParseCached(PROGRAM, cache_path), true), Run(*first, true));
+
+    // Изменённый текст разбирается заново, кэш перезаписывается
+    const string changed = "x = 2\nprint x * 21\n"s;
+    ASSERT_EQUAL(Run(*ParseCached(changed, cache_path), false), "42\n"s);
+    {
+        ifstream in(cache_path, ios::binary);
+        const string data(istreambuf_iterator<char>(in), istreambuf_iterator<char>{});
+        ASSERT(LoadProgram(data, changed) != nullptr);
+    }
+
+    // Испорченный файл кэша не мешает разбору
+    {
+        ofstream out(cache_path, ios::binary | ios::trunc);
+        out << "garbage"sv;
+    }
+    ASSERT_EQUAL(Run(*ParseCached(changed, cache_path), true), "42\n"s);
+
+    filesystem::remove_all(dir);
+}
+
+}  // namespace
+
+void RunCacheTests(TestRunner& tr) {
+    RUN_TEST(tr, cache::TestRoundTrip);
+    RUN_TEST(tr, cache::TestLongChains);
+    RUN_TEST(tr, cache::TestRejectsStaleAndCorruptData);
+    RUN_TEST(tr, cache::TestNestingLimit);
+    RUN_TEST(tr, cache::TestParseCached);
+}
+
+}  // namespace cache
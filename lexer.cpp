@@ -1,13 +1,147 @@
 #include "lexer.h"
 
 #include <algorithm>
+#include <array>
 #include <charconv>
-#include <unordered_map>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
 namespace parse {
 
+	namespace {
+
+		// Классы символов. Символ может принадлежать нескольким классам
+		enum CharClass : uint8_t {
+			SPACE = 1 << 0,       // ' '
+			ID_START = 1 << 1,    // буква или '_': начало идентификатора
+			DIGIT = 1 << 2,       // цифра
+			QUOTE = 1 << 3,       // открывающая кавычка строковой константы
+			COMMENT = 1 << 4,     // начало комментария
+			OPERATOR = 1 << 5,    // односимвольная лексема Char
+			COMPARISON = 1 << 6,  // символ, за которым может следовать '=': ==, !=, <=, >=
+		};
+
+		constexpr array<uint8_t, 256> MakeCharClasses() {
+			array<uint8_t, 256> classes{};
+			classes[static_cast<unsigned char>(' ')] = SPACE;
+			for (char c = 'a'; c <= 'z'; ++c) {
+				classes[static_cast<unsigned char>(c)] = ID_START;
+			}
+			for (char c = 'A'; c <= 'Z'; ++c) {
+				classes[static_cast<unsigned char>(c)] = ID_START;
+			}
+			classes[static_cast<unsigned char>('_')] = ID_START;
+			for (char c = '0'; c <= '9'; ++c) {
+				classes[static_cast<unsigned char>(c)] = DIGIT;
+			}
+			classes[static_cast<unsigned char>('"')] = QUOTE;
+			classes[static_cast<unsigned char>('\'')] = QUOTE;
+			classes[static_cast<unsigned char>('#')] = COMMENT;
+			for (char c : {'.', ',', '(', ')', '+', '-', '*', '/', ':'}) {
+				classes[static_cast<unsigned char>(c)] = OPERATOR;
+			}
+			for (char c : {'=', '<', '>', '!'}) {
+				classes[static_cast<unsigned char>(c)] = COMPARISON;
+			}
+			return classes;
+		}
+
+		constexpr array<uint8_t, 256> CHAR_CLASSES = MakeCharClasses();
+
+		constexpr bool IsOf(char c, uint8_t char_class) {
+			return (CHAR_CLASSES[static_cast<unsigned char>(c)] & char_class) != 0;
+		}
+
+		struct Keyword {
+			string_view name;
+			Token token;
+		};
+
+		constexpr Keyword KEYWORDS[] = {
+			{"class"sv, token_type::Class{}},
+			{"return"sv, token_type::Return{}},
+			{"if"sv, token_type::If{}},
+			{"else"sv, token_type::Else{}},
+			{"def"sv, token_type::Def{}},
+			{"print"sv, token_type::Print{}},
+			{"or"sv, token_type::Or{}},
+			{"None"sv, token_type::None{}},
+			{"and"sv, token_type::And{}},
+			{"not"sv, token_type::Not{}},
+			{"True"sv, token_type::True{}},
+			{"False"sv, token_type::False{}},
+		};
+
+		constexpr size_t KEYWORD_TABLE_SIZE = 16;
+
+		// Совершенная хеш-функция для ключевых слов: у всех KEYWORDS разные значения.
+		// str не пустая
+		constexpr size_t KeywordHash(string_view str) {
+			return (str.size() * 4 + static_cast<unsigned char>(str.front())
+				+ static_cast<unsigned char>(str.back()) * 11) % KEYWORD_TABLE_SIZE;
+		}
+
+		// Таблица ключевых слов, индексируемая KeywordHash. Пустые ячейки содержат пустое имя
+		constexpr array<Keyword, KEYWORD_TABLE_SIZE> MakeKeywordTable() {
+			array<Keyword, KEYWORD_TABLE_SIZE> table{};
+			for (const Keyword& keyword : KEYWORDS) {
+				Keyword& cell = table[KeywordHash(keyword.name)];
+				if (!cell.name.empty()) {
+					throw logic_error("Keyword hash collision");
+				}
+				cell = keyword;
+			}
+			return table;
+		}
+
+		constexpr array<Keyword, KEYWORD_TABLE_SIZE> KEYWORD_TABLE = MakeKeywordTable();
+
+		// Добавляет лексемы изменения отступа при переходе от отступа current к отступу indent.
+		// Отступ увеличивается только на два пробела, уменьшаться может на любое чётное число
+		void AppendIndentTokens(int indent, int& current, vector<Token>& tokens) {
+			int diff = indent - current;
+			if (diff == 2) {
+				current += 2;
+				tokens.push_back(token_type::Indent{});
+			}
+			else if (diff < 0 && diff % 2 == 0) {
+				while (diff < 0) {
+					tokens.push_back(token_type::Dedent{});
+					diff += 2;
+				}
+				current = indent;
+			}
+		}
+
+		// Добавляет лексемы конца текста. Лексемы последней строки начинаются с позиции line_start
+		void AppendEofTokens(int& current, size_t line_count, vector<Token>& tokens, size_t line_start) {
+			// Перед окончанием закрываем все открытые отступы
+			while (current > 0) {
+				tokens.push_back(token_type::Dedent{});
+				current -= 2;
+			}
+
+			// Если строка не пустая и она единственная - зачем-то надо имитировать конец строки
+			if (line_count == 0 && tokens.size() != line_start) {
+				tokens.push_back(token_type::Newline{});
+			}
+
+			tokens.push_back(token_type::Eof{});
+		}
+
+	}  // namespace
+
 	bool operator==(const Token& lhs, const Token& rhs) {
 		using namespace token_type;
 
@@ -75,49 +209,350 @@ namespace parse {
 		return os << "Unknown token :("sv;
 	}
 
+	SourceFile::SourceFile(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw LexerError("Cannot open file "s + path);
+		}
+		struct stat st {};
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping != MAP_FAILED) {
+				mapping_ = mapping;
+				text_ = string_view(static_cast<const char*>(mapping), static_cast<size_t>(st.st_size));
+			}
+		}
+		close(fd);
+		if (mapping_ != nullptr) {
+			return;
+		}
+#endif
+		// Отображение недоступно - читаем файл целиком
+		ifstream input(path, ios::binary);
+		if (!input) {
+			throw LexerError("Cannot open file "s + path);
+		}
+		content_.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+		text_ = content_;
+	}
+
+	SourceFile::~SourceFile() {
+#if defined(__unix__) || defined(__APPLE__)
+		if (mapping_ != nullptr) {
+			munmap(mapping_, text_.size());
+		}
+#endif
+	}
+
 	Lexer::Lexer(std::istream& input)
-		: isit_(input)
+		: stream_(&input)
+		, pos_(nullptr)
+		, end_(nullptr)
+		, curent_indent_(0)
+		, line_count_(0)
+		, scan_(scan::GetKernels())
+	{
+		tokens_.reserve(15);
+		BufferTokens(1);
+	}
+
+	Lexer::Lexer(std::string_view source)
+		: pos_(source.data())
+		, end_(source.data() + source.size())
 		, curent_indent_(0)
-		, curent_tiken_id_(0)
 		, line_count_(0)
+		, scan_(scan::GetKernels())
 	{
-		// Реализуйте конструктор самостоятельно
-		//++isit_;
 		tokens_.reserve(15);
-		NextToken();
+		BufferTokens(1);
+	}
+
+	Lexer::Lexer(TokenArray tokens)
+		: pos_(nullptr)
+		, end_(nullptr)
+		, curent_indent_(0)
+		, line_count_(0)
+		, scan_(scan::GetKernels())
+		, pre_lexed_(true)
+		, pre_lexed_tokens_(move(tokens.tokens))
+		, pre_lexed_strings_(move(tokens.strings))
+		, pre_lexed_error_(move(tokens.error))
+	{
+		BufferTokens(1);
 	}
 
 	const Token& Lexer::CurrentToken() const {
-		return tokens_[curent_tiken_id_];
+		return ring_[ring_head_];
+	}
+
+	const Token& Lexer::NextToken() {
+		PopToken();
+		BufferTokens(1);
+		return ring_[ring_head_];
+	}
+
+	const Token& Lexer::Peek(size_t n) {
+		BufferTokens(n + 1);
+		// За лексемой Eof буфер не пополняется
+		n = min(n, ring_size_ - 1);
+		return ring_[(ring_head_ + n) & (ring_.size() - 1)];
+	}
+
+	void Lexer::BufferTokens(size_t count) {
+		while (ring_size_ < count) {
+			if (ring_size_ > 0 && ring_[(ring_head_ + ring_size_ - 1) & (ring_.size() - 1)].Is<token_type::Eof>()) {
+				return;
+			}
+			BufferNextLine();
+		}
 	}
 
-	Token Lexer::NextToken() {
-		if (curent_tiken_id_ + 1 < tokens_.size()) {
-			return tokens_[++curent_tiken_id_];
+	void Lexer::BufferNextLine() {
+		if (pre_lexed_) {
+			if (pre_lexed_pos_ < pre_lexed_tokens_.size()) {
+				PushToken(pre_lexed_tokens_[pre_lexed_pos_++]);
+				return;
+			}
+			if (pre_lexed_error_) {
+				throw LexerError(*pre_lexed_error_);
+			}
+			PushToken(token_type::Eof{});
+			return;
 		}
 
-		curent_tiken_id_ = 0;
 		tokens_.clear();
 		while (!ParseString());
+		// Строка закрывается, только когда все её лексемы попали в буфер
+		lines_.back().tokens = tokens_.size();
+		line_open_ = false;
+		for (const Token& token : tokens_) {
+			PushToken(token);
+		}
+	}
+
+	void Lexer::PushToken(const Token& token) {
+		if (ring_size_ == ring_.size()) {
+			// Буфер заполнен - переносим лексемы в буфер вдвое большего размера
+			vector<Token> grown(max<size_t>(16, ring_.size() * 2));
+			for (size_t i = 0; i < ring_size_; ++i) {
+				grown[i] = ring_[(ring_head_ + i) & (ring_.size() - 1)];
+			}
+			ring_.swap(grown);
+			ring_head_ = 0;
+		}
+		ring_[(ring_head_ + ring_size_) & (ring_.size() - 1)] = token;
+		++ring_size_;
+	}
+
+	void Lexer::PopToken() {
+		ring_head_ = (ring_head_ + 1) & (ring_.size() - 1);
+		--ring_size_;
+		if (!pre_lexed_ && --lines_.front().tokens == 0) {
+			lines_.pop_front();
+		}
+	}
+
+	// Строка текста, разобранная без учёта отступа
+	struct Lexer::LineInfo {
+		static constexpr int NO_INDENT = -1;
+
+		// Ширина отступа либо NO_INDENT, если отступ строки не учитывается
+		int indent = NO_INDENT;
+		// Количество лексем строки в Chunk::tokens
+		size_t token_count = 0;
+		// false, если строка - последняя строка текста и не заканчивается переводом строки
+		bool terminated = true;
+	};
+
+	// Часть текста, разобранная в отдельном потоке
+	struct Lexer::Chunk {
+		std::vector<LineInfo> lines;
+		std::vector<Token> tokens;
+		std::forward_list<std::string> strings;
+		// Ошибка в строке, следующей за lines
+		std::optional<std::string> error;
+	};
+
+	void Lexer::LexChunk(std::string_view text, Chunk& chunk)
+	{
+		pos_ = text.data();
+		end_ = text.data() + text.size();
+		tokens_.clear();
+		// Раскодированные строки нужны до конца разбора, поэтому хранятся вместе со всей частью
+		unescaped_ = &chunk.strings;
+		try {
+			while (pos_ != end_) {
+				LineInfo line;
+				const size_t first_token = tokens_.size();
+				if (*pos_ != '\n' && !IsOf(*pos_, COMMENT)) {
+					line.indent = MeasureIndent();
+				}
+				ParseLineContent();
+				line.token_count = tokens_.size() - first_token;
+				line.terminated = pos_ != end_;
+				if (line.terminated) {
+					++pos_;
+				}
+				chunk.lines.push_back(line);
+			}
+		}
+		catch (const LexerError& e) {
+			// Лексемы строки с ошибкой отбрасываются
+			size_t line_tokens = 0;
+			for (const LineInfo& line : chunk.lines) {
+				line_tokens += line.token_count;
+			}
+			tokens_.resize(line_tokens, token_type::Eof{});
+			chunk.error = e.what();
+		}
+		chunk.tokens = move(tokens_);
+	}
+
+	TokenArray TokenizeParallel(std::string_view source, size_t chunk_count)
+	{
+		// Части меньше этого размера не окупают запуск потока
+		constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+		if (chunk_count == 0) {
+			chunk_count = max<size_t>(1, min<size_t>(thread::hardware_concurrency(), source.size() / MIN_CHUNK_SIZE));
+		}
+
+		// Границы частей сдвигаются на начало строки, поэтому лексемы не разрываются
+		vector<string_view> texts;
+		size_t begin = 0;
+		for (size_t i = 1; i <= chunk_count && begin < source.size(); ++i) {
+			size_t end = source.size() * i / chunk_count;
+			if (i < chunk_count && end > begin) {
+				end = source.find('\n', end - 1);
+				end = end == string_view::npos ? source.size() : end + 1;
+			}
+			end = max(end, begin);
+			if (end > begin) {
+				texts.push_back(source.substr(begin, end - begin));
+			}
+			begin = end;
+		}
+
+		vector<Lexer::Chunk> chunks(texts.size());
+		{
+			auto lex = [&texts, &chunks](size_t i) {
+				Lexer lexer(string_view{});
+				lexer.LexChunk(texts[i], chunks[i]);
+			};
+			vector<thread> workers;
+			for (size_t i = 1; i < texts.size(); ++i) {
+				workers.emplace_back(lex, i);
+			}
+			if (!texts.empty()) {
+				lex(0);
+			}
+			for (thread& worker : workers) {
+				worker.join();
+			}
+		}
 
-		return tokens_[0];
+		// Сшиваем части, расставляя лексемы отступов так же, как Lexer::ParseString
+		TokenArray result;
+		size_t total_tokens = 0;
+		for (const Lexer::Chunk& chunk : chunks) {
+			total_tokens += chunk.tokens.size() + chunk.lines.size();
+		}
+		result.tokens.reserve(total_tokens + 1);
+
+		vector<Token>& tokens = result.tokens;
+		int indent = 0;
+		size_t line_count = 0;
+		for (Lexer::Chunk& chunk : chunks) {
+			auto token = make_move_iterator(chunk.tokens.begin());
+			for (const Lexer::LineInfo& line : chunk.lines) {
+				const size_t line_start = tokens.size();
+				if (line.indent != Lexer::LineInfo::NO_INDENT) {
+					AppendIndentTokens(line.indent, indent, tokens);
+				}
+				tokens.insert(tokens.end(), token, token + static_cast<ptrdiff_t>(line.token_count));
+				token += static_cast<ptrdiff_t>(line.token_count);
+
+				if (!line.terminated) {
+					AppendEofTokens(indent, line_count, tokens, line_start);
+					result.strings.push_back(move(chunk.strings));
+					return result;
+				}
+				if (tokens.size() != line_start) {
+					tokens.push_back(token_type::Newline{});
+					++line_count;
+				}
+			}
+			result.strings.push_back(move(chunk.strings));
+			if (chunk.error) {
+				result.error = move(chunk.error);
+				return result;
+			}
+		}
+		AppendEofTokens(indent, line_count, tokens, tokens.size());
+		return result;
+	}
+
+	bool Lexer::ReadLine()
+	{
+		// Строка читается в хранилище разбираемой строки: её срезы нужны лексемам String
+		std::string& text = lines_.back().text;
+		if (stream_ == nullptr || !getline(*stream_, text)) {
+			return false;
+		}
+		// Последняя строка текста может не заканчиваться переводом строки
+		if (!stream_->eof()) {
+			text.push_back('\n');
+		}
+		pos_ = text.data();
+		end_ = text.data() + text.size();
+		return true;
 	}
 
 	bool Lexer::ParseString()
 	{
-		while (isit_ != end_ && *isit_ != '\n')
+		// Пустая строка не порождает лексем, поэтому её хранилище используется следующей строкой
+		if (!line_open_) {
+			lines_.emplace_back();
+			line_open_ = true;
+			unescaped_ = &lines_.back().unescaped;
+		}
+		if (pos_ == end_) {
+			ReadLine();
+		}
+		// Отступ не учитывается у пустых строк и строк, начинающихся с комментария
+		if (pos_ != end_ && *pos_ != '\n' && !IsOf(*pos_, COMMENT)) {
+			AppendIndentTokens(MeasureIndent(), curent_indent_, tokens_);
+		}
+		ParseLineContent();
+
+		if (pos_ == end_) {
+			AppendEofTokens(curent_indent_, line_count_, tokens_, 0);
+		}
+		else {
+			++pos_;
+			if (tokens_.size() > 0) {
+				tokens_.push_back(token_type::Newline{});
+				++line_count_;
+			}
+			else {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Lexer::ParseLineContent()
+	{
+		while (pos_ != end_ && *pos_ != '\n')
 		{
 			// Ожидаем комментарии
 			if (ExpectComment()) continue;
 
-			// Ожидаем отступы
-			if (tokens_.size() == 0 && ExpectIndent()) continue;
-
 			// Пропускаем пробелы
 			if (SkipSpace()) continue;
 
 			// Ожидаем строку
-			if (*isit_ == '\"' || *isit_ == '\'') {
+			if (IsOf(*pos_, QUOTE)) {
 				if (ExpectString()) continue;
 			}
 
@@ -130,43 +565,14 @@ namespace parse {
 			// Ожидаем цифры
 			if (ExpectNums()) continue;
 
+			throw LexerError("Unexpected character "s + *pos_);
 		}
-		if (isit_ == end_) {
-			// Перед окончанием закрываем все открытые отступы
-			if (curent_indent_ > 0) {
-				while (curent_indent_ > 0) {
-					tokens_.push_back(token_type::Dedent{});
-					curent_indent_ -= 2;
-				}
-			}
-
-			// Если строка не пустая и она единственная - зачем-то надо имитировать конец строки
-			if (line_count_ == 0 && tokens_.size() != 0) {
-				tokens_.push_back(token_type::Newline{});
-			}
-
-			tokens_.push_back(token_type::Eof{});
-		}
-		else if (*isit_ == '\n') {
-			if (tokens_.size() > 0) {
-				tokens_.push_back(token_type::Newline{});
-				++line_count_;
-				++isit_;
-			}
-			else {
-				++isit_;
-				return false;
-			}
-		}
-		return true;
 	}
 
 	bool Lexer::ExpectComment()
 	{
-		if (*isit_ == '#') {
-			while (isit_ != end_ && *isit_ != '\n') {
-				isit_++;
-			}
+		if (IsOf(*pos_, COMMENT)) {
+			pos_ = scan_.find_line_end(pos_, end_);
 			return true;
 		}
 		return false;
@@ -174,46 +580,24 @@ namespace parse {
 
 	bool Lexer::SkipSpace()
 	{
-		bool skiped = false;
-		while (*isit_ == ' ') {
-			++isit_;
-			skiped = true;
-		}
-		return skiped;
+		const char* start = pos_;
+		pos_ = scan_.skip_spaces(pos_, end_);
+		return pos_ != start;
 	}
 
 	// Вызывается только в начале строки
-	bool Lexer::ExpectIndent()
+	int Lexer::MeasureIndent()
 	{
-		int indent = 0;
-		while (*isit_ == ' ') {
-			++indent; ++isit_;
-		}
-		int diff_indent = indent - curent_indent_;
-		if (diff_indent == 0) {
-			return false;
-		}
-		else if (diff_indent == 2) {
-			curent_indent_ += 2;
-			tokens_.push_back(token_type::Indent{});
-			return true;
-		}
-		else if (diff_indent < 0 && diff_indent % 2 == 0) {
-			while (diff_indent < 0) {
-				tokens_.push_back(token_type::Dedent{});
-				diff_indent += 2;
-			}
-			curent_indent_ = indent;
-			return true;
-		}
-		return false;
+		const char* start = pos_;
+		pos_ = scan_.skip_spaces(pos_, end_);
+		return static_cast<int>(pos_ - start);
 	}
 
-	bool Lexer::ExpectKeyWord(const string_view str)
+	bool Lexer::ExpectKeyWord(string_view str)
 	{
-		auto it = keyword_.find(str);
-		if (it != keyword_.end()) {
-			tokens_.push_back(it->second);
+		const Keyword& keyword = KEYWORD_TABLE[KeywordHash(str)];
+		if (keyword.name == str) {
+			tokens_.push_back(keyword.token);
 			return true;
 		}
 		return false;
@@ -223,141 +607,128 @@ namespace parse {
 	{
 		// идентификатор или ключевое слово
 
-		auto idChar = [](const char c, const bool is_first) {
-			return ((c >= 'a' && c <= 'z')
-				|| (c >= 'A' && c <= 'Z')
-				|| (c == '_')
-				|| (!is_first && c >= '0' && c <= '9'));
-		};
+		if (!IsOf(*pos_, ID_START)) {
+			return false;
+		}
 
-		bool first = true;
-		string str;
+		const char* start = pos_;
+		pos_ = scan_.skip_id_chars(pos_ + 1, end_);
 
-		while (isit_ != end_ && idChar(*isit_, first)) {
-			str += *isit_++;
-			first = false;
+		string_view str(start, static_cast<size_t>(pos_ - start));
+		if (!ExpectKeyWord(str)) {
+			tokens_.push_back(token_type::Id{ Intern(str) });
 		}
+		return true;
+	}
 
-		if (!ExpectKeyWord(str) && str.size() > 0) {
-			tokens_.push_back(token_type::Id{ move(str) });
+	runtime::Symbol Lexer::Intern(string_view str)
+	{
+		auto it = symbols_.find(str);
+		if (it == symbols_.end()) {
+			runtime::Symbol symbol(str);
+			it = symbols_.emplace(symbol.Name(), symbol).first;
 		}
-		return !first;
+		return it->second;
 	}
 
 	bool Lexer::ExpectChars()
 	{
 		// операторы сравнения, состоящие из нескольких символов: ==, >=, <=, !=;
 		// отдельные символы, такие как: '=', '.', ',', '(', '+', '<', '>', ')';
-		char first = *isit_;
-
-		for (const char c : equals_) {
-			if (c == first) {
-				char second = *(++isit_);
-				if (second == '=') {
-					switch (first)
-					{
-					case '=':
-						tokens_.push_back(token_type::Eq{});
-						++isit_;
-						return true;
-					case '>':
-						tokens_.push_back(token_type::GreaterOrEq{});
-						++isit_;
-						return true;
-					case '<':
-						tokens_.push_back(token_type::LessOrEq{});
-						++isit_;
-						return true;
-					case '!':
-						tokens_.push_back(token_type::NotEq{});
-						++isit_;
-						return true;
-					default:
-						throw LexerError("Not equal char"s);
-						break;
-					}
-				}
-				else {
-					tokens_.push_back(token_type::Char{ first });
+		const char first = *pos_;
+
+		if (IsOf(first, COMPARISON)) {
+			++pos_;
+			if (pos_ != end_ && *pos_ == '=') {
+				++pos_;
+				switch (first)
+				{
+				case '=':
+					tokens_.push_back(token_type::Eq{});
+					return true;
+				case '>':
+					tokens_.push_back(token_type::GreaterOrEq{});
+					return true;
+				case '<':
+					tokens_.push_back(token_type::LessOrEq{});
+					return true;
+				default:
+					tokens_.push_back(token_type::NotEq{});
 					return true;
 				}
 			}
+			tokens_.push_back(token_type::Char{ first });
+			return true;
 		}
 
-		for (const char c : chars_) {
-			if (c == first) {
-				tokens_.push_back(token_type::Char{ first });
-				++isit_;
-				return true;
-			}
+		if (IsOf(first, OPERATOR)) {
+			tokens_.push_back(token_type::Char{ first });
+			++pos_;
+			return true;
 		}
 		return false;
 	}
 
 	bool Lexer::ExpectNums()
 	{
-		using namespace std::literals;
-
-		std::string parsed_num;
-
-		// Считывает в parsed_num очередной символ из input
-		auto read_char = [&parsed_num, this] {
-			if (isit_ == end_) {
-				throw LexerError("Failed to read number from stream"s);
-			}
-			parsed_num += static_cast<char>(*isit_++);
-		};
-
-		// Считывает одну или более цифр в parsed_num из input
-		auto read_digits = [read_char, this] {
-			if (!std::isdigit(*isit_)) {
-				return;
-			}
-			while (isit_ != end_ && std::isdigit(*isit_)) {
-				read_char();
-			}
-		};
+		if (!IsOf(*pos_, DIGIT)) {
+			return false;
+		}
 
-		read_digits();
+		// Число разбирается прямо из буфера. При переполнении from_chars всё равно
+		// пропускает все цифры константы
+		std::int64_t value = 0;
+		const auto [end, error] = std::from_chars(pos_, end_, value);
+		if (error == std::errc::result_out_of_range) {
+			throw LexerError("Number is out of range: "s + string(pos_, end));
+		}
+		pos_ = end;
+		tokens_.push_back(token_type::Number{ value });
+		return true;
+	}
 
-		// Пробуем преобразовать строку в int
-		try {
-			tokens_.push_back(token_type::Number{ std::stoi(parsed_num) });
+	bool Lexer::ExpectString()
+	{
+		// Функцию следует использовать, когда pos_ указывает на открывающую кавычку
+		const char quote = *pos_++;
+		const char* start = pos_;
+
+		// Строка без escape-последовательностей передаётся срезом исходного текста
+		pos_ = scan_.find_string_stop(pos_, end_, quote);
+		if (pos_ != end_ && *pos_ == quote) {
+			tokens_.push_back(token_type::String{ string_view(start, static_cast<size_t>(pos_ - start)) });
+			++pos_;
 			return true;
 		}
-		catch (...) {
-			// В случае неудачи, например, при переполнении,
-			return false;
-		}
-		return false;
+
+		pos_ = start;
+		tokens_.push_back(token_type::String{ UnescapeString(quote) });
+		return true;
 	}
 
-	bool Lexer::ExpectString()
+	std::string_view Lexer::UnescapeString(char quote)
 	{
-		// Функцию следует использовать после считывания открывающего символа ":
 		using namespace std::literals;
-		std::string s;
-		const char openChar = *isit_;
-		++isit_;
+		std::string& s = unescaped_->emplace_front();
 		while (true) {
-			if (isit_ == end_) {
+			if (pos_ == end_) {
 				// Поток закончился до того, как встретили закрывающую кавычку?
 				throw LexerError("String parsing error");
 			}
-			const char ch = *isit_;
-			if (ch == openChar) {
+			const char ch = *pos_;
+			if (ch == quote) {
 				// Встретили закрывающую кавычку
-				++isit_;
+				++pos_;
 				break;
 			}
 			else if (ch == '\\') {
 				// Встретили начало escape-последовательности
-				++isit_;
-				if (isit_ == end_) {
+				++pos_;
+				if (pos_ == end_) {
 					// Поток завершился сразу после символа обратной косой черты
 					throw LexerError("String parsing error");
 				}
-				const char escaped_char = *(isit_);
+				const char escaped_char = *pos_;
 				// Обрабатываем одну из последовательностей: \\, \n, \t, \r, \"
 				switch (escaped_char) {
 				case 'n':
@@ -391,10 +762,9 @@ namespace parse {
 				// Просто считываем очередной символ и помещаем его в результирующую строку
 				s.push_back(ch);
 			}
-			++isit_;
+			++pos_;
 		}
-		tokens_.push_back(token_type::String{ move(s) });
-		return true;
+		return s;
 	}
 
-}  // namespace parse
\ No newline at end of file
+}  // namespace parse
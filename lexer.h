@@ -1,25 +1,32 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
+#include <forward_list>
 #include <iosfwd>
 #include <optional>
+#include <unordered_map>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
-#include <unordered_map>
+
+#include "scan.h"
+#include "symbol.h"
 
 namespace parse {
     using namespace std::string_view_literals;
 
     namespace token_type {
-        struct Number {  // Лексема «число»
-            int value;   // число
+        struct Number {          // Лексема «число»
+            std::int64_t value;  // число
         };
 
-        struct Id {             // Лексема «идентификатор»
-            std::string value;  // Имя идентификатора
+        struct Id {                // Лексема «идентификатор»
+            runtime::Symbol value;  // Имя идентификатора
         };
 
         struct Char {    // Лексема «символ»
@@ -27,7 +34,7 @@ namespace parse {
         };
 
         struct String {  // Лексема «строковая константа»
-            std::string value;
+            std::string_view value;
         };
 
         struct Class {};    // Лексема «class»
@@ -60,6 +67,8 @@ namespace parse {
         token_type::Eq, token_type::NotEq, token_type::LessOrEq, token_type::GreaterOrEq,
         token_type::None, token_type::True, token_type::False, token_type::Eof>;
 
+    // Лексема занимает не больше трёх машинных слов и копируется побайтно: числа хранятся в самой
+    // лексеме, идентификаторы - символами общей таблицы, строковые константы - срезами текста
     struct Token : TokenBase {
         using TokenBase::TokenBase;
 
@@ -79,6 +88,8 @@ namespace parse {
         }
     };
 
+    static_assert(std::is_trivially_copyable_v<Token> && sizeof(Token) <= 3 * sizeof(void*));
+
     bool operator==(const Token& lhs, const Token& rhs);
     bool operator!=(const Token& lhs, const Token& rhs);
 
@@ -89,15 +100,70 @@ namespace parse {
         using std::runtime_error::runtime_error;
     };
 
+    // Содержимое файла с исходным текстом. Где возможно, файл отображается в память,
+    // иначе читается целиком
+    class SourceFile {
+    public:
+        explicit SourceFile(const std::string& path);
+        ~SourceFile();
+
+        SourceFile(const SourceFile&) = delete;
+        SourceFile& operator=(const SourceFile&) = delete;
+
+        [[nodiscard]] std::string_view GetText() const {
+            return text_;
+        }
+
+    private:
+        std::string_view text_;
+        // Содержимое файла, если отображение в память недоступно
+        std::string content_;
+        void* mapping_ = nullptr;
+    };
+
+    // Лексемы, заранее разобранные функцией TokenizeParallel
+    struct TokenArray {
+        // Лексемы текста. Если текст разобран без ошибок, последняя лексема - Eof
+        std::vector<Token> tokens;
+        // Раскодированные строковые константы, на которые ссылаются лексемы String
+        std::vector<std::forward_list<std::string>> strings;
+        // Ошибка, встреченная в тексте сразу после лексем tokens
+        std::optional<std::string> error;
+    };
+
+    // Разбивает текст source на chunk_count частей по границам строк и разбирает части параллельно,
+    // каждую в своём потоке. Если chunk_count равен 0, количество частей определяется размером
+    // текста и количеством ядер процессора. Лексемы совпадают с лексемами Lexer(source).
+    // Значения лексем String ссылаются на source и на TokenArray::strings
+    [[nodiscard]] TokenArray TokenizeParallel(std::string_view source, size_t chunk_count = 0);
+
+    // Лексический анализатор. Исходный текст разбирается как непрерывный буфер.
+    // Идентификаторы заносятся в таблицу символов. Значения лексем String - срезы буфера либо,
+    // если в строковой константе встретились escape-последовательности, раскодированные лексером
+    // строки. Разобранные лексемы хранятся в кольцевом буфере; строки текста и раскодированные
+    // строковые константы освобождаются, когда последняя лексема строки покидает буфер.
+    // Ссылки на лексемы, возвращённые лексером, действительны до следующего вызова NextToken или Peek
     class Lexer {
     public:
+        // Разбирает текст, читая его из потока по одной строке: в памяти хранится только текущая
+        // строка, поэтому длина разбираемого текста не ограничена. Поток должен существовать,
+        // пока существует лексер
         explicit Lexer(std::istream& input);
+        // Разбирает текст source. Буфер source должен существовать, пока существует лексер
+        explicit Lexer(std::string_view source);
+        // Выдаёт лексемы, разобранные TokenizeParallel. Если при разборе встретилась ошибка,
+        // выбрасывает LexerError, дойдя до неё
+        explicit Lexer(TokenArray tokens);
 
         // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
         [[nodiscard]] const Token& CurrentToken() const;
 
         // Возвращает следующий токен, либо token_type::Eof, если поток токенов закончился
-        Token NextToken();
+        const Token& NextToken();
+
+        // Возвращает токен, следующий через n токенов после текущего, не продвигаясь по тексту:
+        // Peek(0) - текущий токен. За концом текста возвращает token_type::Eof
+        const Token& Peek(size_t n);
 
         // Если текущий токен имеет тип T, метод возвращает ссылку на него.
         // В противном случае метод выбрасывает исключение LexerError
@@ -140,17 +206,67 @@ namespace parse {
         }
 
     private:
+        // Данные строки текста, на которые ссылаются её лексемы
+        struct Line {
+            std::string text;                          // строка, прочитанная из потока
+            std::forward_list<std::string> unescaped;  // строковые константы с escape-последовательностями
+            size_t tokens = 0;                         // количество лексем строки в буфере
+        };
 
-        // Реализуйте приватную часть самостоятельно
-        std::istreambuf_iterator<char> isit_, end_;
+        std::istream* stream_ = nullptr;        // поток, из которого читается текст, или nullptr
+        const char* pos_;                       // текущая позиция в разбираемом тексте
+        const char* end_;                       // конец разбираемого текста
         int curent_indent_;                     // счетчик текущего отступа
-        std::vector<Token> tokens_;             // буфер с токенами
-        size_t curent_tiken_id_;                // id текущего токена
+        std::vector<Token> tokens_;             // лексемы разбираемой строки
+        // Кольцевой буфер лексем: размер - степень двойки, ring_head_ - текущая лексема
+        std::vector<Token> ring_;
+        size_t ring_head_ = 0;
+        size_t ring_size_ = 0;
+        // Строки, лексемы которых находятся в буфере. Последняя строка может разбираться
+        std::deque<Line> lines_;
+        bool line_open_ = false;                // true, если lines_.back() - разбираемая строка
         size_t line_count_;                     // количество строк
+        std::forward_list<std::string>* unescaped_ = nullptr;  // хранилище раскодированных строк
+        const scan::Kernels& scan_;             // функции поиска символов, выбранные при создании лексера
+        // Символы уже встречавшихся идентификаторов. Ключи ссылаются на имена символов, поэтому
+        // повторный идентификатор не обращается к общей таблице символов
+        std::unordered_map<std::string_view, runtime::Symbol> symbols_;
+        // Лексемы, строковые константы и ошибка, разобранные TokenizeParallel
+        bool pre_lexed_ = false;
+        std::vector<Token> pre_lexed_tokens_;
+        size_t pre_lexed_pos_ = 0;
+        std::vector<std::forward_list<std::string>> pre_lexed_strings_;
+        std::optional<std::string> pre_lexed_error_;
+
+        struct LineInfo;
+        struct Chunk;
+        friend TokenArray TokenizeParallel(std::string_view source, size_t chunk_count);
+
+        // Разбирает строки text в chunk, не обрабатывая отступы: для каждой строки
+        // запоминается ширина отступа, а лексемы отступов расставляются при сшивании частей
+        void LexChunk(std::string_view text, Chunk& chunk);
+
+        // Дополняет буфер, пока в нём не окажется count лексем или лексема Eof
+        void BufferTokens(size_t count);
+
+        // Добавляет в буфер лексемы следующей непустой строки текста
+        void BufferNextLine();
+
+        void PushToken(const Token& token);
+
+        // Убирает из буфера текущую лексему
+        void PopToken();
+
+        // Читает из потока следующую строку текста. Возвращает false, если текст закончился
+        bool ReadLine();
 
         // Парсим входную строку
         bool ParseString();
 
+        // Разбирает лексемы строки текста, начиная с текущей позиции, до перевода строки
+        // или конца текста. Отступ в начале строки должен быть уже пропущен
+        void ParseLineContent();
+
         // Проверяем на комментарий
         bool ExpectComment();
 
@@ -158,10 +274,13 @@ namespace parse {
         bool SkipSpace();
 
         // Ожидаем ключевое слово
-        bool ExpectKeyWord(const std::string_view str);
+        bool ExpectKeyWord(std::string_view str);
 
-        // Ожидаем отступы. Считаем количество токенов с отступами
-        bool ExpectIndent();
+        // Пропускает отступ в начале строки и возвращает его ширину
+        int MeasureIndent();
+
+        // Возвращает символ идентификатора str
+        runtime::Symbol Intern(std::string_view str);
 
         // Ожидаем идентификатор или ключевое слово
         bool ExpectIdKeyWord();
@@ -175,27 +294,9 @@ namespace parse {
         // Ожидаем строку
         bool ExpectString();
 
-        // или числа или строки или комментарий
-
-
-        const std::unordered_map <std::string_view, Token> keyword_{
-            //class return if else def print or None and not True False
-            {"class"sv, token_type::Class{}},
-            {"return"sv, token_type::Return{}},
-            {"if"sv, token_type::If{}},
-            {"else"sv, token_type::Else{}},
-            {"def"sv, token_type::Def{}},
-            {"print"sv, token_type::Print{}},
-            {"or"sv, token_type::Or{}},
-            {"None"sv, token_type::None{}},
-            {"and"sv, token_type::And{}},
-            {"not"sv, token_type::Not{}},
-            {"True"sv, token_type::True{}},
-            {"False"sv, token_type::False{}}
-        };
-
-        const std::vector<char> chars_{ '.', ',', '(', '+', ')', '-', '+', '*', '/', ':' };
-        const std::vector<char> equals_{ '=', '<', '>', '!' };
+        // Раскодирует строковую константу, содержащую escape-последовательности.
+        // pos_ указывает на первый символ после открывающей кавычки
+        std::string_view UnescapeString(char quote);
     };
 
 }  // namespace parse
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "lexer.h"
+#include "scan.h"
 #include "test_runner_p.h"
 
 #include <sstream>
@@ -38,6 +39,12 @@ void TestKeywords() {
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Not{}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::True{}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::False{}));
+
+    // Слова, похожие на ключевые, - идентификаторы
+    for (string_view word : {"classes"sv, "Class"sv, "iff"sv, "el"sv, "ifs"sv, "nOt"sv, "TrueFalse"sv, "x"sv}) {
+        Lexer id_lexer(word);
+        ASSERT_EQUAL(id_lexer.CurrentToken(), Token(token_type::Id{word}));
+    }
 }
 
 void TestNumbers() {
@@ -49,6 +56,13 @@ void TestNumbers() {
     // Отрицательные числа формируются на этапе синтаксического анализа
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'-'}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{53}));
+
+    // Константы 64-битные, переполнение - ошибка лексического анализа
+    Lexer big("9223372036854775807 0042"sv);
+    ASSERT_EQUAL(big.CurrentToken(), Token(token_type::Number{9223372036854775807}));
+    ASSERT_EQUAL(big.NextToken(), Token(token_type::Number{42}));
+    ASSERT_THROWS(Lexer("x = 9223372036854775808"sv), LexerError);
+    ASSERT_THROWS(Lexer("x = 100000000000000000000000000000"sv), LexerError);
 }
 
 void TestIds() {
@@ -351,6 +365,198 @@ abc#
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
     }
 }
+
+void TestSourceBuffer() {
+    const string source = "x = 'plain' + \"esc\\naped\"\nprint x\n"s;
+    Lexer lexer(string_view{source});
+
+    // Идентификаторы - символы общей таблицы, строки без escape-последовательностей - срезы
+    // исходного текста
+    const runtime::Symbol id = lexer.CurrentToken().As<token_type::Id>().value;
+    ASSERT_EQUAL(id, runtime::Symbol("x"sv));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+
+    const Token plain = lexer.NextToken();
+    ASSERT_EQUAL(plain.As<token_type::String>().value, "plain"sv);
+    ASSERT(plain.As<token_type::String>().value.data() == source.data() + 5);
+
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"esc\naped"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+
+    // Неизвестный символ - ошибка, а не бесконечный цикл
+    ASSERT_THROWS(Lexer("x = 1 @ 2"sv), LexerError);
+}
+
+void TestReadsStreamByLine() {
+    istringstream input("x = 'one'\n\n  # comment\ny = 2"s);
+    Lexer lexer(input);
+
+    // Прочитана только первая строка
+    ASSERT_EQUAL(input.tellg(), 10);
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"one"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(input.tellg(), 10);
+
+    // Последняя строка не заканчивается переводом строки
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{2}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestPeek() {
+    // Заглядывание вперёд читает следующие строки, не освобождая строки текущих лексем
+    istringstream input("x = 'one'\ny = 'a\\tb'\nz = \"three\"\n"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.Peek(0), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.Peek(10), Token(token_type::String{"three"sv}));
+    ASSERT_EQUAL(lexer.Peek(6), Token(token_type::String{"a\tb"sv}));
+    ASSERT_EQUAL(lexer.Peek(2), Token(token_type::String{"one"sv}));
+    ASSERT_EQUAL(lexer.Peek(100), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+
+    const vector<Token> expected = {
+        token_type::Char{'='}, token_type::String{"one"sv}, token_type::Newline{},
+        token_type::Id{"y"s}, token_type::Char{'='}, token_type::String{"a\tb"sv}, token_type::Newline{},
+        token_type::Id{"z"s}, token_type::Char{'='}, token_type::String{"three"sv}, token_type::Newline{},
+        token_type::Eof{},
+    };
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(lexer.Peek(expected.size() - i), Token(token_type::Eof{}));
+        ASSERT_EQUAL(lexer.NextToken(), expected[i]);
+    }
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+
+    // Разобранные заранее лексемы выдаются так же, а ошибка выбрасывается при заглядывании на неё
+    Lexer pre_lexed(TokenizeParallel("x = 1\ny = @\n"sv, 1));
+    ASSERT_EQUAL(pre_lexed.Peek(3), Token(token_type::Newline{}));
+    ASSERT_THROWS(pre_lexed.Peek(4), LexerError);
+    ASSERT_EQUAL(pre_lexed.NextToken(), Token(token_type::Char{'='}));
+}
+
+// Возвращает лексемы, выданные лексером, и сообщение об ошибке, если лексер её обнаружил
+string DumpTokens(Lexer& lexer) {
+    ostringstream out;
+    try {
+        while (true) {
+            out << lexer.CurrentToken() << ' ';
+            if (lexer.CurrentToken().Is<token_type::Eof>()) {
+                break;
+            }
+            lexer.NextToken();
+        }
+    } catch (const LexerError& e) {
+        out << "error: "s << e.what();
+    }
+    return out.str();
+}
+
+string DumpSequential(string_view source) {
+    try {
+        Lexer lexer(source);
+        return DumpTokens(lexer);
+    } catch (const LexerError& e) {
+        return "error: "s + e.what();
+    }
+}
+
+string DumpParallel(string_view source, size_t chunk_count) {
+    try {
+        Lexer lexer(TokenizeParallel(source, chunk_count));
+        return DumpTokens(lexer);
+    } catch (const LexerError& e) {
+        return "error: "s + e.what();
+    }
+}
+
+void TestParallelTokenizer() {
+    const string program = R"(# comment at column 0
+class A:
+  def f(self, x):
+    if x:
+      return 'a\tb' + "c"
+  # indented comment
+
+     
+    return None
+   odd = 1
+print A().f(1) >= 2, x.y != 'z'
+)"s;
+    const vector<string> sources = {
+        program,
+        program + "  tail"s,
+        ""s,
+        "\n"s,
+        "x"s,
+        "  x"s,
+        "  x\n"s,
+        "x = 1\n  y = 2"s,
+        "# only comment"s,
+        "x = 1\ny = 'unterminated\nz = 3\n"s,
+        "x = 1\ny = 2 @ 3\nz = 3\n"s,
+        "@"s,
+    };
+    for (const string& source : sources) {
+        const string expected = DumpSequential(source);
+        for (size_t chunk_count : {1, 2, 3, 5, 16, 100}) {
+            ASSERT_EQUAL(DumpParallel(source, chunk_count), expected);
+        }
+        ASSERT_EQUAL(DumpParallel(source, 0), expected);
+    }
+}
+
+void TestScanKernels() {
+    using namespace scan;
+
+    // Длинные участки, чтобы искомый символ попадал в разные места блоков по 16 и 32 байта
+    string text;
+    text += string(70, ' ') + "long_identifier_"s + string(40, 'x') + "_42\xff\x80"s;
+    text += " '"s + string(50, 'a') + "\\q\"rest\r\n"s + string(33, '-') + "\n"s;
+    text += "#"s + string(90, '.') + "\n"s + string(20, ' ') + "Z"s;
+
+    const Kernels& scalar = GetKernels(Kernel::Scalar);
+    for (Kernel kernel : {Kernel::Sse2, Kernel::Avx2}) {
+        if (!IsSupported(kernel)) {
+            continue;
+        }
+        const Kernels& vectorized = GetKernels(kernel);
+        ASSERT(vectorized.kernel == kernel);
+        const char* end = text.data() + text.size();
+        for (const char* begin = text.data(); begin != end; ++begin) {
+            ASSERT(vectorized.skip_spaces(begin, end) == scalar.skip_spaces(begin, end));
+            ASSERT(vectorized.find_line_end(begin, end) == scalar.find_line_end(begin, end));
+            ASSERT(vectorized.skip_id_chars(begin, end) == scalar.skip_id_chars(begin, end));
+            ASSERT(vectorized.find_string_stop(begin, end, '"') == scalar.find_string_stop(begin, end, '"'));
+            ASSERT(vectorized.find_string_stop(begin, end, '\'') == scalar.find_string_stop(begin, end, '\''));
+        }
+    }
+
+    // Лексер выдаёт одни и те же лексемы при любой реализации поиска
+    const string program = "class "s + string(40, 'C') + ":\n  def m(self):"s + string(35, ' ')
+        + "# "s + string(60, '#') + "\n    return '"s + string(45, 's') + "' + \"t\\n\"\n"s;
+    auto tokenize = [&program](Kernel kernel) {
+        SetKernel(kernel);
+        ostringstream out;
+        for (Lexer lexer(string_view{program}); !lexer.CurrentToken().Is<token_type::Eof>(); lexer.NextToken()) {
+            out << lexer.CurrentToken() << ' ';
+        }
+        return out.str();
+    };
+    const string expected = tokenize(Kernel::Scalar);
+    ASSERT_EQUAL(tokenize(Kernel::Sse2), expected);
+    ASSERT_EQUAL(tokenize(Kernel::Avx2), expected);
+}
+
 }  // namespace
 
 void RunOpenLexerTests(TestRunner& tr) {
@@ -367,6 +573,11 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestMythonProgram);
     RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
     RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestSourceBuffer);
+    RUN_TEST(tr, parse::TestReadsStreamByLine);
+    RUN_TEST(tr, parse::TestPeek);
+    RUN_TEST(tr, parse::TestScanKernels);
+    RUN_TEST(tr, parse::TestParallelTokenizer);
 }
 
 }  // namespace parse
\ No newline at end of file
@@ -1,10 +1,16 @@
+#include "cache.h"
 #include "lexer.h"
 #include "parse.h"
 #include "runtime.h"
+#include "scan.h"
 #include "statement.h"
 #include "test_runner_p.h"
+#include "vm.h"
 
+#include <chrono>
 #include <iostream>
+#include <iterator>
+#include <string_view>
 
 using namespace std;
 
@@ -22,15 +28,120 @@ void RunObjectsTests(TestRunner& tr);
 
 void TestParseProgram(TestRunner& tr);
 
+namespace vm {
+void RunVmTests(TestRunner& tr);
+}  // namespace vm
+
+namespace cache {
+void RunCacheTests(TestRunner& tr);
+}  // namespace cache
+
 namespace {
 
-void RunMythonProgram(istream& input, ostream& output) {
+// Способ исполнения программы
+enum class Engine {
+    Ast,  // обход синтаксического дерева
+    Vm,   // компиляция в байткод и исполнение виртуальной машиной
+};
+
+// Параметры разбора и исполнения
+struct Options {
+    ParseOptions parse;
+    size_t max_call_depth = runtime::Context::DEFAULT_MAX_CALL_DEPTH;
+};
+
+void RunMythonProgram(runtime::Executable& program, ostream& output, Engine engine, const Options& options = {}) {
+    runtime::SimpleContext context{output};
+    context.SetMaxCallDepth(options.max_call_depth);
+    runtime::Closure closure;
+    if (engine == Engine::Vm) {
+        vm::Execute(program, closure, context);
+    } else {
+        program.Execute(closure, context);
+    }
+}
+
+void RunMythonProgram(parse::Lexer& lexer, ostream& output, Engine engine, const Options& options = {}) {
+    auto program = ParseProgram(lexer, options.parse);
+    RunMythonProgram(*program, output, engine, options);
+}
+
+void RunMythonProgram(istream& input, ostream& output, Engine engine = Engine::Ast, const Options& options = {}) {
     parse::Lexer lexer(input);
-    auto program = ParseProgram(lexer);
+    RunMythonProgram(lexer, output, engine, options);
+}
+
+// Разбирает и выполняет инструкции верхнего уровня по одной, освобождая каждую после выполнения
+void RunMythonProgramStreaming(parse::Lexer& lexer, ostream& output, Engine engine, const Options& options = {}) {
+    StatementParser parser(lexer, options.parse);
 
     runtime::SimpleContext context{output};
+    context.SetMaxCallDepth(options.max_call_depth);
     runtime::Closure closure;
-    program->Execute(closure, context);
+    bytecode::Program compiled(nullptr);
+    while (auto statement = parser.ParseNext()) {
+        if (engine == Engine::Vm) {
+            vm::Execute(*statement, compiled, closure, context);
+        } else {
+            statement->Execute(closure, context);
+        }
+    }
+}
+
+// Повторяет run, пока не наберётся достаточное для измерения время, и возвращает скорость
+// разбора в МБ/с. Каждый вызов run разбирает bytes байт
+template <typename Fn>
+double MeasureThroughput(size_t bytes, Fn run) {
+    using Clock = chrono::steady_clock;
+
+    size_t total = 0;
+    const auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do {
+        run();
+        total += bytes;
+        elapsed = Clock::now() - start;
+    } while (elapsed < chrono::milliseconds(500));
+
+    return total / chrono::duration<double>(elapsed).count() / (1024 * 1024);
+}
+
+// Разбирает text до конца
+void LexAll(string_view text) {
+    parse::Lexer lexer(text);
+    while (!lexer.CurrentToken().Is<parse::token_type::Eof>()) {
+        lexer.NextToken();
+    }
+}
+
+// Измеряет скорость лексического анализа text каждой поддерживаемой реализацией поиска символов
+void BenchmarkLexer(string_view text, ostream& output) {
+    using namespace parse::scan;
+
+    for (Kernel kernel : {Kernel::Scalar, Kernel::Sse2, Kernel::Avx2}) {
+        if (!IsSupported(kernel)) {
+            continue;
+        }
+        SetKernel(kernel);
+        output << GetKernelName(kernel) << ": "sv << MeasureThroughput(text.size(), [text] {
+            LexAll(text);
+        }) << " MB/s"sv << endl;
+    }
+    SetKernel(Kernel::Avx2);
+
+    // Параллельный разбор лучшей реализацией поиска символов
+    output << "parallel: "sv << MeasureThroughput(text.size(), [text] {
+        parse::TokenArray tokens = parse::TokenizeParallel(text);
+    }) << " MB/s"sv << endl;
+
+    // Текст, состоящий в основном из числовых констант
+    string numbers;
+    for (uint64_t i = 0; numbers.size() < (1 << 20); ++i) {
+        numbers += "x = "s + to_string(i * 2654435761) + " + "s + to_string(i % 1000) + '\n';
+    }
+    output << "numbers: "sv << MeasureThroughput(numbers.size(), [&numbers] {
+        LexAll(numbers);
+    }) << " MB/s"sv << endl;
 }
 
 void TestSimplePrints() {
@@ -76,6 +187,14 @@ void TestArithmetics() {
     RunMythonProgram(input, output);
 
     ASSERT_EQUAL(output.str(), "15 120 -13 3 15\n");
+
+    // Числа 64-битные в обоих исполнителях
+    for (Engine engine : {Engine::Ast, Engine::Vm}) {
+        istringstream big_input("print 2147483647 + 1, 3000000000 * 3, -9000000000 / 2");
+        ostringstream big_output;
+        RunMythonProgram(big_input, big_output, engine);
+        ASSERT_EQUAL(big_output.str(), "2147483648 9000000000 -4500000000\n");
+    }
 }
 
 void TestVariablesArePointers() {
@@ -111,6 +230,78 @@ print y.value
     ASSERT_EQUAL(output.str(), "2\n3\n");
 }
 
+void TestStreamingExecution() {
+    const string program = R"(
+print 'first'
+one = 1
+word = 'ab'
+print one + one, word + word
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add():
+    self.value = self.value + 1
+    return self.value
+
+c = Counter()
+c.add()
+if c.add() == 2:
+  print c.value
+else:
+  print 'wrong'
+print unknown
+)"s;
+
+    for (Engine engine : {Engine::Ast, Engine::Vm}) {
+        istringstream input(program);
+        parse::Lexer lexer(input);
+        ostringstream output;
+        // Инструкции, предшествующие ошибочной, уже выполнены
+        ASSERT_THROWS(RunMythonProgramStreaming(lexer, output, engine), std::runtime_error);
+        ASSERT_EQUAL(output.str(), "first\n2 abab\n2\n"s);
+    }
+}
+
+void TestLazyMethods() {
+    const string program = R"(
+class Greeter:
+  def __init__(name):
+    self.name = name
+
+  def greet():
+    return 'Hello, ' + self.name + '!'
+
+  def broken():
+    return Missing()
+
+class Missing:
+  def __init__():
+    self.value = 0
+
+g = Greeter('world')
+print g.greet()
+print g.broken()
+)"s;
+
+    Options options;
+    options.parse.lazy_methods = true;
+    for (Engine engine : {Engine::Ast, Engine::Vm}) {
+        for (bool stream : {false, true}) {
+            istringstream input(program);
+            parse::Lexer lexer(input);
+            ostringstream output;
+            // Ошибка в теле метода обнаруживается только при его вызове
+            if (stream) {
+                ASSERT_THROWS(RunMythonProgramStreaming(lexer, output, engine, options), ParseError);
+            } else {
+                ASSERT_THROWS(RunMythonProgram(lexer, output, engine, options), ParseError);
+            }
+            ASSERT_EQUAL(output.str(), "Hello, world!\n"s);
+        }
+    }
+}
+
 void TestAll() {
     TestRunner tr;
     parse::RunOpenLexerTests(tr);
@@ -118,20 +309,93 @@ void TestAll() {
     runtime::RunObjectsTests(tr);
     ast::RunUnitTests(tr);
     TestParseProgram(tr);
+    vm::RunVmTests(tr);
+    cache::RunCacheTests(tr);
 
     RUN_TEST(tr, TestSimplePrints);
     RUN_TEST(tr, TestAssignments);
     RUN_TEST(tr, TestArithmetics);
     RUN_TEST(tr, TestVariablesArePointers);
+    RUN_TEST(tr, TestStreamingExecution);
+    RUN_TEST(tr, TestLazyMethods);
 }
 
 }  // namespace
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Ключ --vm включает исполнение программы виртуальной машиной, ключ --stream - выполнение
+    // инструкций верхнего уровня по мере их разбора,
+    // ключ --bench-lexer вместо исполнения измеряет скорость лексического анализа.
+    // Если указан файл, программа читается из него, иначе - из стандартного ввода.
+    // Разобранная программа из файла кэшируется рядом с ним либо в каталоге, заданном
+    // ключом --cache-dir; ключ --no-cache отключает кэш.
+    // Ключи --max-depth N и --max-call-depth N задают наибольшую вложенность конструкций программы
+    // и вызовов методов. Ключ --lazy откладывает разбор тел методов до их первого вызова;
+    // кэш при этом не используется, так как хранит разобранные тела. Ключ --parse-threads N задаёт
+    // количество потоков, разбирающих тела методов, 0 - по количеству ядер
+    Engine engine = Engine::Ast;
+    Options options;
+    bool bench_lexer = false;
+    bool stream = false;
+    bool use_cache = true;
+    string cache_dir;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i] == "--vm"sv) {
+            engine = Engine::Vm;
+        } else if (argv[i] == "--ast"sv) {
+            engine = Engine::Ast;
+        } else if (argv[i] == "--stream"sv) {
+            stream = true;
+        } else if (argv[i] == "--bench-lexer"sv) {
+            bench_lexer = true;
+        } else if (argv[i] == "--lazy"sv) {
+            options.parse.lazy_methods = true;
+        } else if (argv[i] == "--parse-threads"sv && i + 1 < argc) {
+            options.parse.method_threads = stoul(argv[++i]);
+        } else if (argv[i] == "--no-cache"sv) {
+            use_cache = false;
+        } else if (argv[i] == "--cache-dir"sv && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (argv[i] == "--max-depth"sv && i + 1 < argc) {
+            options.parse.max_depth = stoul(argv[++i]);
+        } else if (argv[i] == "--max-call-depth"sv && i + 1 < argc) {
+            options.max_call_depth = stoul(argv[++i]);
+        } else {
+            path = argv[i];
+        }
+    }
+
     try {
         TestAll();
 
-        RunMythonProgram(cin, cout);
+        if (bench_lexer) {
+            if (path != nullptr) {
+                parse::SourceFile source(path);
+                BenchmarkLexer(source.GetText(), cout);
+            } else {
+                const string text(istreambuf_iterator<char>(cin), istreambuf_iterator<char>{});
+                BenchmarkLexer(text, cout);
+            }
+        } else if (path != nullptr) {
+            parse::SourceFile source(path);
+            if (stream) {
+                parse::Lexer lexer(source.GetText());
+                RunMythonProgramStreaming(lexer, cout, engine, options);
+            } else if (use_cache && !options.parse.lazy_methods) {
+                auto program = cache::ParseCached(source.GetText(), cache::GetCachePath(path, cache_dir),
+                    options.parse);
+                RunMythonProgram(*program, cout, engine, options);
+            } else {
+                parse::Lexer lexer(parse::TokenizeParallel(source.GetText()));
+                RunMythonProgram(lexer, cout, engine, options);
+            }
+        } else if (stream) {
+            parse::Lexer lexer(cin);
+            RunMythonProgramStreaming(lexer, cout, engine, options);
+        } else {
+            RunMythonProgram(cin, cout, engine, options);
+        }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
 		return 1;
@@ -3,6 +3,22 @@
 #include "lexer.h"
 #include "statement.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+
 using namespace std;
 
 namespace TokenType = parse::token_type;
@@ -17,27 +33,276 @@ bool operator!=(const parse::Token& token, char c) {
     return !(token == c);
 }
 
+// Приоритеты операций в порядке возрастания
+enum class Precedence {
+    Lowest,      // не операция
+    Or,
+    And,
+    Not,
+    Comparison,
+    Sum,
+    Product,
+    Max,
+};
+
+// Бинарная операция
+struct BinaryOperator {
+    Precedence precedence = Precedence::Lowest;
+    // false, если операции этого приоритета не объединяются в цепочки, как a < b < c
+    bool associative = true;
+    unique_ptr<ast::Statement> (*make)(unique_ptr<ast::Statement> lhs, unique_ptr<ast::Statement> rhs) = nullptr;
+};
+
+template <typename Node>
+BinaryOperator MakeOperator(Precedence precedence) {
+    return {precedence, true, [](unique_ptr<ast::Statement> lhs, unique_ptr<ast::Statement> rhs) -> unique_ptr<ast::Statement> {
+        return make_unique<Node>(std::move(lhs), std::move(rhs));
+    }};
+}
+
+template <bool (*Cmp)(const runtime::ObjectHolder&, const runtime::ObjectHolder&, runtime::Context&)>
+BinaryOperator MakeComparison() {
+    return {Precedence::Comparison, false, [](unique_ptr<ast::Statement> lhs, unique_ptr<ast::Statement> rhs) -> unique_ptr<ast::Statement> {
+        return make_unique<ast::Comparison>(Cmp, std::move(lhs), std::move(rhs));
+    }};
+}
+
+// Бинарные операции, проиндексированные видом лексемы, а для лексемы Char - её символом
+struct OperatorTable {
+    array<BinaryOperator, variant_size_v<parse::TokenBase>> by_token;
+    array<BinaryOperator, 256> by_char;
+};
+
+const OperatorTable OPERATORS = [] {
+    OperatorTable table;
+    auto token = [&table](parse::Token token) -> BinaryOperator& {
+        return table.by_token[token.index()];
+    };
+    auto chr = [&table](char c) -> BinaryOperator& {
+        return table.by_char[static_cast<unsigned char>(c)];
+    };
+    token(TokenType::Or{}) = MakeOperator<ast::Or>(Precedence::Or);
+    token(TokenType::And{}) = MakeOperator<ast::And>(Precedence::And);
+    chr('<') = MakeComparison<runtime::Less>();
+    chr('>') = MakeComparison<runtime::Greater>();
+    token(TokenType::Eq{}) = MakeComparison<runtime::Equal>();
+    token(TokenType::NotEq{}) = MakeComparison<runtime::NotEqual>();
+    token(TokenType::LessOrEq{}) = MakeComparison<runtime::LessOrEqual>();
+    token(TokenType::GreaterOrEq{}) = MakeComparison<runtime::GreaterOrEqual>();
+    chr('+') = MakeOperator<ast::Add>(Precedence::Sum);
+    chr('-') = MakeOperator<ast::Sub>(Precedence::Sum);
+    chr('*') = MakeOperator<ast::Mult>(Precedence::Product);
+    chr('/') = MakeOperator<ast::Div>(Precedence::Product);
+    return table;
+}();
+
+// Возвращает операцию, обозначаемую лексемой token. Для остальных лексем приоритет операции - Lowest
+const BinaryOperator& FindBinaryOperator(const parse::Token& token) {
+    if (const auto* c = token.TryAs<TokenType::Char>()) {
+        return OPERATORS.by_char[static_cast<unsigned char>(c->value)];
+    }
+    return OPERATORS.by_token[token.index()];
+}
+
+// Объявленные классы: номер объявления и класс. Классы не принадлежат таблице: как и узлы
+// ast::NewInstance, тела методов рассчитывают, что объявленные классы живут не меньше них
+using ClassTable = unordered_map<runtime::Symbol, pair<size_t, const runtime::Class*>>;
+
+// Возвращает класс с заданным именем, объявленный вне разбираемого текста и видимый ему, или nullptr
+using ClassLookup = function<const runtime::Class*(runtime::Symbol)>;
+
+// Тело метода, разбор которого отложен до первого вызова
+class DeferredMethodBody : public runtime::MethodSource {
+public:
+    // tokens - лексемы тела от перевода строки перед ним до закрывающего Dedent. Тело видит
+    // visible_classes первых классов таблицы classes и вложено в конструкции глубины depth
+    DeferredMethodBody(parse::TokenArray tokens, const ParseOptions& options, size_t depth,
+                       shared_ptr<ClassTable> classes, size_t visible_classes)
+        : tokens_(std::move(tokens))
+        , options_(options)
+        , depth_(depth)
+        , classes_(std::move(classes))
+        , visible_classes_(visible_classes) {
+    }
+
+    void Parse(const runtime::Method& method) const override;
+
+private:
+    parse::TokenArray tokens_;
+    ParseOptions options_;
+    size_t depth_;
+    shared_ptr<ClassTable> classes_;
+    size_t visible_classes_;
+};
+
+// Разбирает отложенные тела методов methods в thread_count потоках, 0 - по количеству тел и ядер.
+// Если разбор нескольких тел завершился ошибкой, выбрасывается ошибка первого из них
+void LoadMethods(const vector<const runtime::Method*>& methods, size_t thread_count) {
+    // Меньшее количество тел не окупает запуск потока
+    constexpr size_t MIN_METHODS_PER_THREAD = 64;
+    if (thread_count == 0) {
+        thread_count = min<size_t>(thread::hardware_concurrency(), methods.size() / MIN_METHODS_PER_THREAD);
+    }
+    thread_count = max<size_t>(1, min(thread_count, methods.size()));
+
+    vector<exception_ptr> errors(methods.size());
+    atomic<size_t> next = 0;
+    auto load = [&methods, &errors, &next] {
+        for (size_t i; (i = next.fetch_add(1, memory_order_relaxed)) < methods.size();) {
+            try {
+                methods[i]->Load();
+            } catch (...) {
+                errors[i] = current_exception();
+            }
+        }
+    };
+    vector<thread> workers;
+    for (size_t i = 1; i < thread_count; ++i) {
+        workers.emplace_back(load);
+    }
+    load();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
 class Parser {
 public:
-    explicit Parser(parse::Lexer& lexer)
-        : lexer_(lexer) {
+    // Разбираемый текст видит классы, объявленные в нём самом и найденные outer_classes
+    Parser(parse::Lexer& lexer, const ParseOptions& options, ClassLookup outer_classes = nullptr)
+        : lexer_(lexer)
+        , options_(options)
+        , classes_(make_shared<ClassTable>())
+        , outer_classes_(std::move(outer_classes)) {
+    }
+
+    // Разбирает отложенное тело метода: видны только visible_classes первых классов таблицы classes
+    Parser(parse::Lexer& lexer, const ParseOptions& options, size_t depth,
+           shared_ptr<ClassTable> classes, size_t visible_classes)
+        : lexer_(lexer)
+        , options_(options)
+        , depth_(depth)
+        , classes_(std::move(classes))
+        , visible_classes_(visible_classes) {
     }
 
     // Program -> eps
     //          | Statement \n Program
     unique_ptr<ast::Statement> ParseProgram() {
-        auto result = make_unique<ast::Compound>();
-        while (!lexer_.CurrentToken().Is<TokenType::Eof>()) {
-            result->AddStatement(ParseStatement());
+        return WithDeferredMethods([this] {
+            auto result = make_unique<ast::Compound>();
+            while (auto statement = ParseTopLevelStatement()) {
+                result->AddStatement(std::move(statement));
+            }
+            return result;
+        });
+    }
+
+    // Возвращает очередную инструкцию верхнего уровня или nullptr, если программа закончилась
+    unique_ptr<ast::Statement> ParseNextStatement() {
+        return WithDeferredMethods([this] {
+            return ParseTopLevelStatement();
+        });
+    }
+
+    // Возвращает классы, объявленные разобранным текстом
+    [[nodiscard]] const runtime::Closure& GetDeclaredClasses() const {
+        return declared_classes_;
+    }
+
+    // Разбирает тело метода m и заполняет m.body и m.frame_size
+    void ParseMethodBody(const runtime::Method& m) {
+        // Тело метода может объявить класс, после методов которого продолжается разбор этого тела
+        auto outer_scope = std::move(scope_);
+        const size_t outer_frame_size = frame_size_;
+
+        // Слот 0 - self, за ним идут параметры. Остальные слоты получают локальные переменные
+        scope_.emplace();
+        (*scope_)[runtime::SELF] = 0;
+        for (size_t i = 0; i < m.formal_params.size(); ++i) {
+            (*scope_)[m.formal_params[i]] = i + 1;
         }
+        frame_size_ = m.formal_params.size() + 1;
 
-        return result;
+        m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+        m.frame_size = frame_size_;
+        scope_ = std::move(outer_scope);
+        frame_size_ = outer_frame_size;
     }
 
 private:
+    // Выполняет parse и разбирает тела методов, отложенные для параллельного разбора. Если ошибка
+    // встретилась и в отложенном теле, и после него, выбрасывается ошибка тела: до неё дошёл бы
+    // и последовательный разбор
+    template <typename Fn>
+    unique_ptr<ast::Statement> WithDeferredMethods(Fn parse) {
+        try {
+            auto result = parse();
+            LoadDeferredMethods();
+            return result;
+        } catch (...) {
+            LoadDeferredMethods();
+            throw;
+        }
+    }
+
+    void LoadDeferredMethods() {
+        vector<const runtime::Method*> methods;
+        methods.swap(deferred_methods_);
+        LoadMethods(methods, options_.method_threads);
+    }
+
+    unique_ptr<ast::Statement> ParseTopLevelStatement() {
+        if (lexer_.CurrentToken().Is<TokenType::Eof>()) {
+            return nullptr;
+        }
+        return ParseStatement();
+    }
+
+    // Тела методов просматриваются, а разбираются при первом вызове либо параллельно
+    bool SkipsMethodBodies() const {
+        return options_.lazy_methods || options_.method_threads != 1;
+    }
+
+    // Восстанавливает глубину вложенности при выходе из разбираемой конструкции
+    class NestingScope {
+    public:
+        explicit NestingScope(Parser& parser)
+            : parser_(parser)
+            , depth_(parser.depth_) {
+        }
+
+        ~NestingScope() {
+            parser_.depth_ = depth_;
+        }
+
+        NestingScope(const NestingScope&) = delete;
+        NestingScope& operator=(const NestingScope&) = delete;
+
+    private:
+        Parser& parser_;
+        size_t depth_;
+    };
+
+    // Переходит на следующий уровень вложенности
+    void Nest() {
+        if (++depth_ > options_.max_depth) {
+            throw ParseError("Nesting depth exceeds the limit of "s + to_string(options_.max_depth));
+        }
+    }
+
     // Suite -> NEWLINE INDENT (Statement)+ DEDENT
     unique_ptr<ast::Statement> ParseSuite()  // NOLINT
     {
+        NestingScope scope(*this);
+        Nest();
+
         lexer_.Expect<TokenType::Newline>();
         lexer_.ExpectNext<TokenType::Indent>();
 
@@ -54,6 +319,39 @@ private:
         return result;
     }
 
+    // Пропускает тело метода, запоминая его лексемы для разбора при первом вызове.
+    // Возвращает nullptr, не сдвигаясь по тексту, если тело объявляет класс или не является
+    // блоком: такое тело разбирается сразу
+    unique_ptr<runtime::MethodSource> SkipMethodBody() {
+        if (!lexer_.CurrentToken().Is<TokenType::Newline>() || !lexer_.Peek(1).Is<TokenType::Indent>()) {
+            return nullptr;
+        }
+
+        parse::TokenArray body;
+        body.tokens.push_back(lexer_.CurrentToken());
+        auto& strings = body.strings.emplace_back();
+        size_t level = 0;
+        do {
+            parse::Token token = lexer_.Peek(body.tokens.size());
+            if (token.Is<TokenType::Indent>()) {
+                ++level;
+            } else if (token.Is<TokenType::Dedent>()) {
+                --level;
+            } else if (token.Is<TokenType::Class>() || token.Is<TokenType::Eof>()) {
+                return nullptr;
+            } else if (auto* str = get_if<TokenType::String>(&token)) {
+                // Строки текста освобождаются лексером, поэтому константы копируются
+                str->value = strings.emplace_front(str->value);
+            }
+            body.tokens.push_back(token);
+        } while (level > 0);
+
+        for (size_t i = 0; i < body.tokens.size(); ++i) {
+            lexer_.NextToken();
+        }
+        return make_unique<DeferredMethodBody>(std::move(body), options_, depth_, classes_, classes_->size());
+    }
+
     // Methods -> [def id(Params) : Suite]*
     vector<runtime::Method> ParseMethods()  // NOLINT
     {
@@ -63,12 +361,13 @@ private:
             runtime::Method m;
 
             m.name = lexer_.ExpectNext<TokenType::Id>().value;
+            m.id = runtime::InternMethodName(m.name);
             lexer_.ExpectNext<TokenType::Char>('(');
 
             if (lexer_.NextToken().Is<TokenType::Id>()) {
-                m.formal_params.push_back(lexer_.Expect<TokenType::Id>().value);
+                m.formal_params.emplace_back(lexer_.Expect<TokenType::Id>().value);
                 while (lexer_.NextToken() == ',') {
-                    m.formal_params.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+                    m.formal_params.emplace_back(lexer_.ExpectNext<TokenType::Id>().value);
                 }
             }
 
@@ -76,7 +375,12 @@ private:
             lexer_.ExpectNext<TokenType::Char>(':');
             lexer_.NextToken();
 
-            m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            if (SkipsMethodBodies()) {
+                m.source = SkipMethodBody();
+            }
+            if (!m.source) {
+                ParseMethodBody(m);
+            }
 
             result.push_back(std::move(m));
         }
@@ -86,21 +390,20 @@ private:
     // ClassDefinition -> Id ['(' Id ')'] : new_line indent MethodList dedent
     unique_ptr<ast::Statement> ParseClassDefinition()  // NOLINT
     {
-        string class_name = lexer_.Expect<TokenType::Id>().value;
+        runtime::Symbol class_name = lexer_.Expect<TokenType::Id>().value;
 
         lexer_.NextToken();
 
         const runtime::Class* base_class = nullptr;
         if (lexer_.CurrentToken() == '(') {
-            auto& name = lexer_.ExpectNext<TokenType::Id>().value;
+            runtime::Symbol name = lexer_.ExpectNext<TokenType::Id>().value;
             lexer_.ExpectNext<TokenType::Char>(')');
             lexer_.NextToken();
 
-            auto it = declared_classes_.find(name);
-            if (it == declared_classes_.end()) {
-                throw ParseError("Base class "s + name + " not found for class "s + class_name);
+            base_class = FindClass(name);
+            if (base_class == nullptr) {
+                throw ParseError("Base class "s + name.Name() + " not found for class "s + class_name.Name());
             }
-            base_class = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
         }
 
         lexer_.Expect<TokenType::Char>(':');
@@ -117,18 +420,59 @@ private:
             runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class)),
         });
 
-        if (!inserted) {
-            throw ParseError("Class "s + class_name + " already exists"s);
+        if (!inserted || (outer_classes_ && outer_classes_(class_name))) {
+            throw ParseError("Class "s + class_name.Name() + " already exists"s);
+        }
+        const auto* cls = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
+        const size_t index = classes_->size();
+        classes_->emplace(class_name, make_pair(index, cls));
+        if (!options_.lazy_methods) {
+            for (const runtime::Method& method : cls->GetMethods()) {
+                if (method.source) {
+                    deferred_methods_.push_back(&method);
+                }
+            }
         }
 
+        // ClassDefinition связывает класс с именем в Closure, поэтому в теле метода имя класса
+        // ищется по имени, а не в слоте кадра
+        if (scope_) {
+            (*scope_)[class_name] = ast::VariableValue::NO_SLOT;
+        }
         return make_unique<ast::ClassDefinition>(it->second);
     }
 
-    vector<string> ParseDottedIds() {
-        vector<string> result(1, lexer_.Expect<TokenType::Id>().value);
+    // Возвращает класс name, объявленный до разбираемого кода, или nullptr
+    const runtime::Class* FindClass(runtime::Symbol name) const {
+        if (auto it = classes_->find(name); it != classes_->end()) {
+            return it->second.first < visible_classes_ ? it->second.second : nullptr;
+        }
+        return outer_classes_ ? outer_classes_(name) : nullptr;
+    }
+
+    // Возвращает слот переменной name в кадре разбираемого метода.
+    // Вне метода переменные не разрешаются в слоты и ищутся по имени
+    size_t ResolveSlot(runtime::Symbol name) {
+        if (!scope_) {
+            return ast::VariableValue::NO_SLOT;
+        }
+        auto [it, inserted] = scope_->emplace(name, frame_size_);
+        if (inserted) {
+            ++frame_size_;
+        }
+        return it->second;
+    }
+
+    unique_ptr<ast::VariableValue> MakeVariableValue(vector<runtime::Symbol> dotted_ids) {
+        size_t slot = ResolveSlot(dotted_ids.front());
+        return make_unique<ast::VariableValue>(std::move(dotted_ids), slot);
+    }
+
+    vector<runtime::Symbol> ParseDottedIds() {
+        vector<runtime::Symbol> result(1, lexer_.Expect<TokenType::Id>().value);
 
         while (lexer_.NextToken() == '.') {
-            result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+            result.emplace_back(lexer_.ExpectNext<TokenType::Id>().value);
         }
 
         return result;
@@ -137,102 +481,64 @@ private:
     //  AssgnOrCall -> DottedIds = Expr
     //               | DottedIds '(' ExprList ')'
     unique_ptr<ast::Statement> ParseAssignmentOrCall() {
-        lexer_.Expect<TokenType::Id>();
+        runtime::Symbol name = lexer_.Expect<TokenType::Id>().value;
 
-        vector<string> id_list = ParseDottedIds();
-        string last_name = id_list.back();
+        // Присваивание переменной распознаётся заглядыванием вперёд, без списка имён
+        if (lexer_.Peek(1) == '=') {
+            lexer_.NextToken();
+            lexer_.NextToken();
+            size_t slot = ResolveSlot(name);
+            return make_unique<ast::Assignment>(name, ParseTest(), slot);
+        }
+
+        vector<runtime::Symbol> id_list = ParseDottedIds();
+        runtime::Symbol last_name = id_list.back();
         id_list.pop_back();
 
         if (lexer_.CurrentToken() == '=') {
             lexer_.NextToken();
 
             if (id_list.empty()) {
-                return make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+                size_t slot = ResolveSlot(last_name);
+                return make_unique<ast::Assignment>(last_name, ParseTest(), slot);
             }
-            return make_unique<ast::FieldAssignment>(ast::VariableValue{std::move(id_list)},
-                                                     std::move(last_name), ParseTest());
+            return make_unique<ast::FieldAssignment>(std::move(*MakeVariableValue(std::move(id_list))),
+                                                     last_name, ParseTest());
         }
         lexer_.Expect<TokenType::Char>('(');
         lexer_.NextToken();
 
         if (id_list.empty()) {
-            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
+            throw ParseError("Mython doesn't support functions, only methods: "s + last_name.Name());
         }
 
         vector<unique_ptr<ast::Statement>> args;
         if (lexer_.CurrentToken() != ')') {
-            args = ParseTestList();
+            args = ParseArguments();
         }
         lexer_.Expect<TokenType::Char>(')');
         lexer_.NextToken();
 
-        return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
+        return make_unique<ast::MethodCall>(MakeVariableValue(std::move(id_list)),
                                             std::move(last_name), std::move(args));
     }
 
-    // Expr -> Adder ['+'/'-' Adder]*
-    unique_ptr<ast::Statement> ParseExpression()  // NOLINT
-    {
-        unique_ptr<ast::Statement> result = ParseAdder();
-        while (lexer_.CurrentToken() == '+' || lexer_.CurrentToken() == '-') {
-            char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-            lexer_.NextToken();
-
-            if (op == '+') {
-                result = make_unique<ast::Add>(std::move(result), ParseAdder());
-            } else {
-                result = make_unique<ast::Sub>(std::move(result), ParseAdder());
-            }
-        }
-        return result;
-    }
-
-    // Adder -> Mult ['*'/'/' Mult]*
-    unique_ptr<ast::Statement> ParseAdder()  // NOLINT
-    {
-        unique_ptr<ast::Statement> result = ParseMult();
-        while (lexer_.CurrentToken() == '*' || lexer_.CurrentToken() == '/') {
-            char op = lexer_.CurrentToken().As<TokenType::Char>().value;
-            lexer_.NextToken();
-
-            if (op == '*') {
-                result = make_unique<ast::Mult>(std::move(result), ParseMult());
-            } else {
-                result = make_unique<ast::Div>(std::move(result), ParseMult());
-            }
-        }
-        return result;
-    }
-
-    // Mult -> '(' Expr ')'
-    //       | NUMBER
-    //       | '-' Mult
+    // Atom -> NUMBER
     //       | STRING
     //       | NONE
     //       | TRUE
     //       | FALSE
     //       | DottedIds '(' ExprList ')'
     //       | DottedIds
-    unique_ptr<ast::Statement> ParseMult()  // NOLINT
+    unique_ptr<ast::Statement> ParseAtom()  // NOLINT
     {
-        if (lexer_.CurrentToken() == '(') {
-            lexer_.NextToken();
-            auto result = ParseTest();
-            lexer_.Expect<TokenType::Char>(')');
-            lexer_.NextToken();
-            return result;
-        }
-        if (lexer_.CurrentToken() == '-') {
-            lexer_.NextToken();
-            return make_unique<ast::Mult>(ParseMult(), make_unique<ast::NumericConst>(-1));
-        }
         if (const auto* num = lexer_.CurrentToken().TryAs<TokenType::Number>()) {
-            int result = num->value;
+            std::int64_t result = num->value;
             lexer_.NextToken();
             return make_unique<ast::NumericConst>(result);
         }
         if (const auto* str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
-            string result = str->value;
+            string result(str->value);
             lexer_.NextToken();
             return make_unique<ast::StringConst>(std::move(result));
         }
@@ -253,28 +559,27 @@ private:
     }
 
     std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
-        vector<string> names = ParseDottedIds();
+        vector<runtime::Symbol> names = ParseDottedIds();
 
         if (lexer_.CurrentToken() == '(') {
             // various calls
             vector<unique_ptr<ast::Statement>> args;
             if (lexer_.NextToken() != ')') {
-                args = ParseTestList();
+                args = ParseArguments();
             }
             lexer_.Expect<TokenType::Char>(')');
             lexer_.NextToken();
 
-            string method_name = names.back();
+            runtime::Symbol method_name = names.back();
             names.pop_back();
 
             if (!names.empty()) {
                 return make_unique<ast::MethodCall>(
-                    make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
+                    MakeVariableValue(std::move(names)), method_name,
                     std::move(args));
             }
-            if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
-                return make_unique<ast::NewInstance>(
-                    static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
+            if (const runtime::Class* cls = FindClass(method_name)) {
+                return make_unique<ast::NewInstance>(*cls, std::move(args));
             }
             if (method_name == "str"sv) {
                 if (args.size() != 1) {
@@ -282,9 +587,17 @@ private:
                 }
                 return make_unique<ast::Stringify>(std::move(args.front()));
             }
-            throw ParseError("Unknown call to "s + method_name + "()"s);
+            throw ParseError("Unknown call to "s + method_name.Name() + "()"s);
         }
-        return make_unique<ast::VariableValue>(std::move(names));
+        return MakeVariableValue(std::move(names));
+    }
+
+    // Аргументы вызова вложены в вызов
+    vector<unique_ptr<ast::Statement>> ParseArguments()  // NOLINT
+    {
+        NestingScope scope(*this);
+        Nest();
+        return ParseTestList();
     }
 
     vector<unique_ptr<ast::Statement>> ParseTestList()  // NOLINT
@@ -323,77 +636,112 @@ private:
                                         std::move(else_body));
     }
 
-    // LogicalExpr -> AndTest [OR AndTest]
-    // AndTest -> NotTest [AND NotTest]
-    // NotTest -> [NOT] NotTest
-    //          | Comparison
+    // Test -> Mult [BINARY_OP Test]*
+    //       | NOT Test
+    // Mult -> '(' Test ')'
+    //       | '-' Mult
+    //       | Atom
+    // Операции разбираются по приоритетам из таблицы OPERATORS. Операции, ожидающие разбора
+    // своего операнда, хранятся в явном стеке, поэтому ни длина выражения, ни вложенность
+    // скобок не расходуют стек вызовов
     unique_ptr<ast::Statement> ParseTest()  // NOLINT
     {
-        auto result = ParseAndTest();
-        while (lexer_.CurrentToken().Is<TokenType::Or>()) {
-            lexer_.NextToken();
-            result = make_unique<ast::Or>(std::move(result), ParseAndTest());
-        }
-        return result;
-    }
-
-    unique_ptr<ast::Statement> ParseAndTest()  // NOLINT
-    {
-        auto result = ParseNotTest();
-        while (lexer_.CurrentToken().Is<TokenType::And>()) {
-            lexer_.NextToken();
-            result = make_unique<ast::And>(std::move(result), ParseNotTest());
-        }
-        return result;
-    }
-
-    unique_ptr<ast::Statement> ParseNotTest()  // NOLINT
-    {
-        if (lexer_.CurrentToken().Is<TokenType::Not>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Not>(ParseNotTest());  // NOLINT
-        }
-        return ParseComparison();
-    }
+        // Отложенная операция
+        struct Frame {
+            enum class Kind : uint8_t {
+                Binary,  // бинарная операция op ждёт правого операнда, левый - lhs
+                Not,
+                Negate,
+                Parens,
+            };
+
+            Kind kind;
+            // Приоритет, выше которого были операции выражения, прерванного этой операцией
+            Precedence min;
+            const BinaryOperator* op = nullptr;
+            unique_ptr<ast::Statement> lhs;
+        };
+
+        NestingScope scope(*this);
+        vector<Frame> stack;
+        // Разбирается выражение, операции которого имеют приоритет выше min
+        Precedence min = Precedence::Lowest;
+        while (true) {
+            // Префиксные операции и открывающие скобки откладываются до разбора операнда.
+            // После унарного минуса операндом может быть только Mult
+            bool after_minus = false;
+            unique_ptr<ast::Statement> result;
+            while (!result) {
+                const parse::Token& token = lexer_.CurrentToken();
+                if (!after_minus && min < Precedence::Not && token.Is<TokenType::Not>()) {
+                    // not применяется к сравнениям и связывает слабее них, но сильнее and
+                    lexer_.NextToken();
+                    Nest();
+                    stack.push_back({Frame::Kind::Not, min, nullptr, nullptr});
+                    min = Precedence::And;
+                } else if (token == '(') {
+                    lexer_.NextToken();
+                    stack.push_back({Frame::Kind::Parens, min, nullptr, nullptr});
+                    min = Precedence::Lowest;
+                    after_minus = false;
+                } else if (token == '-') {
+                    lexer_.NextToken();
+                    stack.push_back({Frame::Kind::Negate, min, nullptr, nullptr});
+                    after_minus = true;
+                } else {
+                    result = ParseAtom();
+                }
+            }
 
-    // Comparison -> Expr [COMP_OP Expr]
-    unique_ptr<ast::Statement> ParseComparison()  // NOLINT
-    {
-        auto result = ParseExpression();
+            // Операции с приоритетом не ниже ceiling к result уже не применяются: их операнды
+            // разобраны до result, а сравнения не объединяются в цепочки
+            Precedence ceiling = Precedence::Max;
+            while (true) {
+                if (!stack.empty() && stack.back().kind == Frame::Kind::Negate) {
+                    result = make_unique<ast::Mult>(std::move(result), make_unique<ast::NumericConst>(-1));
+                    stack.pop_back();
+                    continue;
+                }
 
-        const auto& tok = lexer_.CurrentToken();
+                const BinaryOperator& op = FindBinaryOperator(lexer_.CurrentToken());
+                if (op.precedence > min && op.precedence < ceiling) {
+                    // Правый операнд содержит только операции с большим приоритетом,
+                    // поэтому операции одного приоритета выполняются слева направо
+                    lexer_.NextToken();
+                    Nest();
+                    stack.push_back({Frame::Kind::Binary, min, &op, std::move(result)});
+                    min = op.precedence;
+                    break;
+                }
 
-        if (tok == '<') {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Less, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok == '>') {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Greater, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::Eq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Equal, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::NotEq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::LessOrEq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result),
-                                                ParseExpression());
-        }
-        if (tok.Is<TokenType::GreaterOrEq>()) {
-            lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
-                                                ParseExpression());
+                // Выражение уровня min закончилось: result - операнд отложенной операции
+                if (stack.empty()) {
+                    return result;
+                }
+                Frame& frame = stack.back();
+                switch (frame.kind) {
+                    case Frame::Kind::Binary:
+                        result = frame.op->make(std::move(frame.lhs), std::move(result));
+                        ceiling = frame.op->associative
+                                      ? static_cast<Precedence>(static_cast<int>(frame.op->precedence) + 1)
+                                      : frame.op->precedence;
+                        --depth_;
+                        break;
+                    case Frame::Kind::Not:
+                        result = make_unique<ast::Not>(std::move(result));
+                        ceiling = Precedence::Not;
+                        --depth_;
+                        break;
+                    default:
+                        lexer_.Expect<TokenType::Char>(')');
+                        lexer_.NextToken();
+                        ceiling = Precedence::Max;
+                        break;
+                }
+                min = frame.min;
+                stack.pop_back();
+            }
         }
-        return result;
     }
 
     // Statement -> SimpleStatement Newline
@@ -423,6 +771,9 @@ private:
         const auto& tok = lexer_.CurrentToken();
 
         if (tok.Is<TokenType::Return>()) {
+            if (!scope_) {
+                throw ParseError("Return outside of a method"s);
+            }
             lexer_.NextToken();
             return make_unique<ast::Return>(ParseTest());
         }
@@ -438,11 +789,440 @@ private:
     }
 
     parse::Lexer& lexer_;
+    const ParseOptions options_;
+    // Текущая глубина вложенности, см. ParseOptions
+    size_t depth_ = 0;
+    // Классы, объявленные этим разборщиком
     runtime::Closure declared_classes_;
+    // Все классы, видимые разбираемому коду, и количество видимых первых классов таблицы
+    shared_ptr<ClassTable> classes_;
+    size_t visible_classes_ = numeric_limits<size_t>::max();
+    ClassLookup outer_classes_;
+    // Тела методов, ожидающие параллельного разбора, в порядке объявления
+    vector<const runtime::Method*> deferred_methods_;
+    // Слоты переменных разбираемого метода; пусто вне тела метода
+    optional<unordered_map<runtime::Symbol, size_t>> scope_;
+    size_t frame_size_ = 0;
 };
 
+void DeferredMethodBody::Parse(const runtime::Method& method) const {
+    // Лексемы копируются, чтобы при ошибке разбора её можно было повторить при следующем вызове
+    parse::Lexer lexer(parse::TokenArray{tokens_.tokens, {}, nullopt});
+    Parser{lexer, options_, depth_, classes_, visible_classes_}.ParseMethodBody(method);
+}
+
 }  // namespace
 
-unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
-    return Parser{lexer}.ParseProgram();
+unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer, const ParseOptions& options) {
+    return Parser{lexer, options}.ParseProgram();
+}
+
+class StatementParser::Impl : public Parser {
+public:
+    using Parser::Parser;
+};
+
+StatementParser::StatementParser(parse::Lexer& lexer, const ParseOptions& options)
+    : impl_(make_unique<Impl>(lexer, options)) {
+}
+
+StatementParser::~StatementParser() = default;
+
+unique_ptr<runtime::Executable> StatementParser::ParseNext() {
+    return impl_->ParseNextStatement();
+}
+
+class IncrementalParser::Impl {
+public:
+    Impl(string text, const ParseOptions& options)
+        : text_(std::move(text))
+        , options_(options) {
+        options_.lazy_methods = false;
+        options_.method_threads = 1;
+        for (size_t length : SplitUnits(0, text_.size())) {
+            units_.push_back(make_unique<Unit>());
+            units_.back()->length = length;
+        }
+        Renumber(0);
+        set<size_t> pending;
+        for (size_t i = 0; i < units_.size(); ++i) {
+            pending.insert(i);
+        }
+        ReparsePending(std::move(pending));
+    }
+
+    void Edit(size_t offset, size_t length, string_view replacement) {
+        if (offset > text_.size() || length > text_.size() - offset) {
+            throw out_of_range("Edit is out of the text"s);
+        }
+        reparsed_count_ = 0;
+
+        // Правка может присоединить к соседней части свои строки или отделить от неё новые части,
+        // поэтому заново делятся на части затронутые правкой части вместе с соседями
+        const size_t first = max<size_t>(FindUnit(offset), 1) - 1;
+        const size_t last = min(FindUnit(offset + length) + 1, units_.size() - 1);
+        const size_t region_begin = units_[first]->begin;
+        const size_t old_region_end = units_[last]->begin + units_[last]->length;
+        const string old_region = text_.substr(region_begin, old_region_end - region_begin);
+
+        text_.replace(offset, length, replacement);
+        const size_t new_region_end = old_region_end - length + replacement.size();
+        const vector<size_t> lengths = SplitUnits(region_begin, new_region_end);
+        const size_t old_count = last - first + 1;
+
+        // Части, текст которых не изменился, сохраняются
+        size_t prefix = 0;
+        for (size_t begin = 0; prefix < min(lengths.size(), old_count); ++prefix) {
+            const size_t unit_length = units_[first + prefix]->length;
+            if (lengths[prefix] != unit_length
+                || text_.compare(region_begin + begin, unit_length, old_region, begin, unit_length) != 0) {
+                break;
+            }
+            begin += unit_length;
+        }
+        size_t suffix = 0;
+        for (size_t old_end = old_region.size(), new_end = new_region_end - region_begin;
+             prefix + suffix < min(lengths.size(), old_count); ++suffix) {
+            const size_t unit_length = units_[last - suffix]->length;
+            if (lengths[lengths.size() - 1 - suffix] != unit_length
+                || text_.compare(region_begin + new_end - unit_length, unit_length, old_region,
+                                 old_end - unit_length, unit_length) != 0) {
+                break;
+            }
+            old_end -= unit_length;
+            new_end -= unit_length;
+        }
+
+        // Остальные части региона заменяются новыми. Части, ссылающиеся на классы удалённых
+        // частей, разбираются заново
+        const size_t replaced = first + prefix;
+        const size_t removed_count = old_count - prefix - suffix;
+        vector<runtime::Symbol> changed;
+        size_t removed_statements = 0;
+        for (size_t i = replaced; i < replaced + removed_count; ++i) {
+            Unit& unit = *units_[i];
+            for (const auto& [name, cls] : unit.classes) {
+                changed.push_back(name);
+            }
+            Unregister(unit);
+            RetireClasses(unit);
+            removed_statements += unit.statement_count;
+        }
+        const size_t first_removed_statement
+            = replaced > 0 ? units_[replaced - 1]->first_statement + units_[replaced - 1]->statement_count : 0;
+        program_.ReplaceStatements(first_removed_statement, removed_statements, {});
+        const auto position = units_.begin() + static_cast<ptrdiff_t>(replaced);
+        units_.erase(position, position + static_cast<ptrdiff_t>(removed_count));
+
+        const size_t added_count = lengths.size() - prefix - suffix;
+        vector<unique_ptr<Unit>> added(added_count);
+        for (size_t i = 0; i < added_count; ++i) {
+            added[i] = make_unique<Unit>();
+            added[i]->length = lengths[prefix + i];
+        }
+        units_.insert(units_.begin() + static_cast<ptrdiff_t>(replaced), make_move_iterator(added.begin()),
+                      make_move_iterator(added.end()));
+        Renumber(replaced);
+
+        set<size_t> pending;
+        for (size_t i = replaced; i < replaced + added_count; ++i) {
+            pending.insert(i);
+        }
+        for (runtime::Symbol name : changed) {
+            AddDependents(name, replaced, pending);
+        }
+        ReparsePending(std::move(pending));
+
+        if (retired_classes_.size() > max(declarations_.size(), MIN_RETIRED_CLASSES)) {
+            ReparseAll();
+        }
+    }
+
+    [[nodiscard]] const string& GetText() const {
+        return text_;
+    }
+
+    runtime::Executable& GetProgram() {
+        for (const auto& unit : units_) {
+            if (unit->error) {
+                rethrow_exception(unit->error);
+            }
+        }
+        return program_;
+    }
+
+    [[nodiscard]] size_t GetReparsedCount() const {
+        return reparsed_count_;
+    }
+
+private:
+    // Часть текста: инструкция верхнего уровня со строками её блоков и ветки else, а также
+    // следующие за ней пустые строки и комментарии
+    struct Unit {
+        size_t begin = 0;
+        size_t length = 0;
+        // Номер части в тексте
+        size_t order = 0;
+        // Инструкции части в дереве программы
+        size_t first_statement = 0;
+        size_t statement_count = 0;
+        // Идентификаторы, встречающиеся в части, без повторов
+        vector<runtime::Symbol> names;
+        // Классы, объявленные частью
+        runtime::Closure classes;
+        // Ошибка разбора части
+        exception_ptr error;
+        bool has_tokens = false;
+        // Часть разобрана как последняя часть текста без завершающего перевода строки,
+        // которой предшествуют лексемы
+        bool after_tokens = false;
+    };
+
+    // Возвращает true, если строка line начинает часть текста: в ней нет отступа и она не пуста,
+    // не является комментарием и не продолжает инструкцию if веткой else
+    static bool StartsUnit(string_view line) {
+        if (line.empty() || line[0] == ' ' || line[0] == '\n' || line[0] == '#') {
+            return false;
+        }
+        if (line.substr(0, 4) != "else"sv) {
+            return true;
+        }
+        const char next = line.size() > 4 ? line[4] : '\n';
+        return isalnum(static_cast<unsigned char>(next)) != 0 || next == '_';
+    }
+
+    // Делит текст от begin до end на части и возвращает их длины. Первая часть начинается с begin
+    [[nodiscard]] vector<size_t> SplitUnits(size_t begin, size_t end) const {
+        const string_view text = string_view(text_).substr(0, end);
+        vector<size_t> lengths;
+        size_t unit_begin = begin;
+        for (size_t pos = text.find('\n', begin); pos != string_view::npos && pos + 1 < end;
+             pos = text.find('\n', pos + 1)) {
+            if (StartsUnit(text.substr(pos + 1))) {
+                lengths.push_back(pos + 1 - unit_begin);
+                unit_begin = pos + 1;
+            }
+        }
+        lengths.push_back(end - unit_begin);
+        return lengths;
+    }
+
+    // Возвращает номер части, содержащей байт offset, или последней части, если offset - конец текста
+    [[nodiscard]] size_t FindUnit(size_t offset) const {
+        const auto it = upper_bound(units_.begin() + 1, units_.end(), offset, [](size_t value, const auto& unit) {
+            return value < unit->begin;
+        });
+        return static_cast<size_t>(it - units_.begin()) - 1;
+    }
+
+    // Пересчитывает положение частей, начиная с части from
+    void Renumber(size_t from) {
+        size_t begin = 0;
+        size_t statement = 0;
+        if (from > 0) {
+            const Unit& previous = *units_[from - 1];
+            begin = previous.begin + previous.length;
+            statement = previous.first_statement + previous.statement_count;
+        }
+        for (size_t i = from; i < units_.size(); ++i) {
+            Unit& unit = *units_[i];
+            unit.order = i;
+            unit.begin = begin;
+            unit.first_statement = statement;
+            begin += unit.length;
+            statement += unit.statement_count;
+        }
+    }
+
+    // Добавляет в pending части с номерами не меньше from, ссылающиеся на имя name
+    void AddDependents(runtime::Symbol name, size_t from, set<size_t>& pending) const {
+        if (auto it = references_.find(name); it != references_.end()) {
+            for (const Unit* unit : it->second) {
+                if (unit->order >= from) {
+                    pending.insert(unit->order);
+                }
+            }
+        }
+    }
+
+    // Разбирает части pending по порядку вместе с частями, которые ссылаются на классы,
+    // объявленные разобранными частями прежде или теперь
+    void ReparsePending(set<size_t> pending) {
+        while (!pending.empty()) {
+            const size_t index = *pending.begin();
+            pending.erase(pending.begin());
+            for (runtime::Symbol name : Reparse(*units_[index])) {
+                AddDependents(name, index + 1, pending);
+            }
+        }
+        // Лексер дописывает перевод строки в конец текста, только если до последней строки не было
+        // лексем, поэтому последняя часть зависит от предыдущих
+        Unit& last = *units_.back();
+        if (last.after_tokens != IsAfterTokens(last)) {
+            Reparse(last);
+        }
+    }
+
+    [[nodiscard]] bool IsAfterTokens(const Unit& unit) const {
+        if (unit.order + 1 != units_.size() || text_.empty() || text_.back() == '\n') {
+            return false;
+        }
+        return any_of(units_.begin(), units_.begin() + static_cast<ptrdiff_t>(unit.order), [](const auto& other) {
+            return other->has_tokens;
+        });
+    }
+
+    // Возвращает класс name, объявленный частью, предшествующей части unit, или nullptr
+    const runtime::Class* FindDeclaredClass(runtime::Symbol name, const Unit& unit) const {
+        const auto it = declarations_.find(name);
+        if (it == declarations_.end() || it->second->order >= unit.order) {
+            return nullptr;
+        }
+        return static_cast<const runtime::Class*>(it->second->classes.at(name).Get());  // NOLINT
+    }
+
+    void Unregister(Unit& unit) {
+        for (runtime::Symbol name : unit.names) {
+            if (auto it = references_.find(name); it != references_.end()) {
+                it->second.erase(&unit);
+                if (it->second.empty()) {
+                    references_.erase(it);
+                }
+            }
+        }
+        for (const auto& [name, cls] : unit.classes) {
+            if (auto it = declarations_.find(name); it != declarations_.end() && it->second == &unit) {
+                declarations_.erase(it);
+            }
+        }
+    }
+
+    // Кэши вызовов методов и обращений к полям в сохранённых узлах помнят адреса классов и их форм.
+    // Заменённые классы не удаляются, чтобы по их адресам не оказались новые классы
+    void RetireClasses(Unit& unit) {
+        for (auto& [name, cls] : unit.classes) {
+            retired_classes_.push_back(std::move(cls));
+        }
+        unit.classes.clear();
+    }
+
+    // Разбирает весь текст заново. Прежние узлы удаляются вместе с кэшами, после чего
+    // заменённые классы больше не нужны
+    void ReparseAll() {
+        set<size_t> pending;
+        for (const auto& unit : units_) {
+            Unregister(*unit);
+            RetireClasses(*unit);
+            unit->statement_count = 0;
+            pending.insert(unit->order);
+        }
+        program_.ReplaceStatements(0, program_.GetStatements().size(), {});
+        Renumber(0);
+        retired_classes_.clear();
+        reparsed_count_ = 0;
+        ReparsePending(std::move(pending));
+    }
+
+    // Разбирает часть заново и возвращает имена классов, которые часть объявляла прежде и объявляет теперь
+    vector<runtime::Symbol> Reparse(Unit& unit) {
+        ++reparsed_count_;
+        vector<runtime::Symbol> changed;
+        for (const auto& [name, cls] : unit.classes) {
+            changed.push_back(name);
+        }
+        Unregister(unit);
+        RetireClasses(unit);
+
+        const string_view text = string_view(text_).substr(unit.begin, unit.length);
+        parse::TokenArray tokens = parse::TokenizeParallel(text, 1);
+        auto& token_list = tokens.tokens;
+        unit.has_tokens = any_of(token_list.begin(), token_list.end(), [](const parse::Token& token) {
+            return !token.Is<TokenType::Eof>();
+        });
+        unit.after_tokens = IsAfterTokens(unit);
+        if (unit.after_tokens && token_list.size() >= 2 && token_list[token_list.size() - 2].Is<TokenType::Newline>()) {
+            token_list.erase(token_list.end() - 2);
+        }
+
+        unit.names.clear();
+        for (const parse::Token& token : token_list) {
+            if (const auto* id = token.TryAs<TokenType::Id>()) {
+                unit.names.push_back(id->value);
+            }
+        }
+        sort(unit.names.begin(), unit.names.end());
+        unit.names.erase(unique(unit.names.begin(), unit.names.end()), unit.names.end());
+        for (runtime::Symbol name : unit.names) {
+            references_[name].insert(&unit);
+        }
+
+        vector<unique_ptr<ast::Statement>> statements;
+        unit.error = nullptr;
+        try {
+            parse::Lexer lexer(std::move(tokens));
+            Parser parser(lexer, options_, [this, &unit](runtime::Symbol name) {
+                return FindDeclaredClass(name, unit);
+            });
+            while (auto statement = parser.ParseNextStatement()) {
+                statements.push_back(std::move(statement));
+            }
+            unit.classes = parser.GetDeclaredClasses();
+        } catch (...) {
+            statements.clear();
+            unit.error = current_exception();
+        }
+
+        const size_t old_count = unit.statement_count;
+        unit.statement_count = statements.size();
+        program_.ReplaceStatements(unit.first_statement, old_count, std::move(statements));
+        if (unit.statement_count != old_count) {
+            Renumber(unit.order + 1);
+        }
+
+        for (const auto& [name, cls] : unit.classes) {
+            Unit*& declaration = declarations_[name];
+            if (declaration == nullptr || declaration->order > unit.order) {
+                declaration = &unit;
+            }
+            changed.push_back(name);
+        }
+        return changed;
+    }
+
+    string text_;
+    ParseOptions options_;
+    vector<unique_ptr<Unit>> units_;
+    // Инструкции всех частей в порядке текста
+    ast::Compound program_;
+    // Части, в которых встречается идентификатор
+    unordered_map<runtime::Symbol, unordered_set<const Unit*>> references_;
+    // Часть, объявившая класс первой
+    unordered_map<runtime::Symbol, Unit*> declarations_;
+    // Классы, объявленные частями прежде: полный разбор выполняется, когда их становится больше,
+    // чем объявленных, но не меньше MIN_RETIRED_CLASSES
+    static constexpr size_t MIN_RETIRED_CLASSES = 64;
+    vector<runtime::ObjectHolder> retired_classes_;
+    size_t reparsed_count_ = 0;
+};
+
+IncrementalParser::IncrementalParser(string text, const ParseOptions& options)
+    : impl_(make_unique<Impl>(std::move(text), options)) {
+}
+
+IncrementalParser::~IncrementalParser() = default;
+
+void IncrementalParser::Edit(size_t offset, size_t length, string_view replacement) {
+    impl_->Edit(offset, length, replacement);
+}
+
+const string& IncrementalParser::GetText() const {
+    return impl_->GetText();
+}
+
+runtime::Executable& IncrementalParser::GetProgram() {
+    return impl_->GetProgram();
+}
+
+size_t IncrementalParser::GetReparsedCount() const {
+    return impl_->GetReparsedCount();
 }
\ No newline at end of file
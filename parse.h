@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 
 namespace parse {
 class Lexer;
@@ -15,4 +18,79 @@ struct ParseError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
\ No newline at end of file
+// Параметры разбора
+struct ParseOptions {
+    // Наибольшая глубина вложенности блоков, списков аргументов вызовов, правых операндов
+    // и операндов not. Дерево такой глубины обходится рекурсивно, поэтому ограничение защищает
+    // стек при разборе и исполнении. Левые операнды цепочек вида a + b + c и скобки глубину
+    // не увеличивают: такие цепочки разбираются и исполняются без рекурсии при любой длине
+    size_t max_depth = 1000;
+    // Тела методов при загрузке только просматриваются, а разбираются при первом вызове метода
+    // (runtime::Method::Load), поэтому время загрузки и память зависят от исполняемого кода,
+    // а не от объёма объявленных классов. Синтаксические ошибки тела обнаруживаются при первом
+    // вызове метода. Тело, объявляющее класс, разбирается сразу
+    bool lazy_methods = false;
+    // Количество потоков, разбирающих тела методов. Если потоков больше одного, тела сначала
+    // только просматриваются, как при lazy_methods, а после разбора программы или, при разборе
+    // по инструкциям, очередной инструкции разбираются параллельно. Дерево и ошибки разбора
+    // совпадают с последовательным разбором. 0 - количество потоков определяется количеством
+    // тел и ядер процессора. Не действует вместе с lazy_methods
+    size_t method_threads = 1;
+};
+
+// Разбирает программу. Превышение ограничений options - ошибка разбора ParseError
+std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer, const ParseOptions& options = {});
+
+// Разбирает программу по одной инструкции верхнего уровня. Разобранную инструкцию можно сразу
+// выполнить и освободить, поэтому память, занимаемая деревом, ограничена размером наибольшей
+// инструкции, а не длиной программы. Классы, объявленные в разобранных инструкциях,
+// остаются доступны последующим инструкциям
+class StatementParser {
+public:
+    explicit StatementParser(parse::Lexer& lexer, const ParseOptions& options = {});
+    ~StatementParser();
+
+    StatementParser(const StatementParser&) = delete;
+    StatementParser& operator=(const StatementParser&) = delete;
+
+    // Возвращает очередную инструкцию верхнего уровня или nullptr, если программа закончилась
+    std::unique_ptr<runtime::Executable> ParseNext();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// Разбирает программу и обновляет её дерево при правках текста. Текст делится на части:
+// инструкция верхнего уровня вместе со строками её блоков, ветки else, пустыми строками
+// и комментариями. Правка заново разбирает на лексемы и инструкции только изменённые части,
+// а также части, ссылающиеся на классы, объявления которых разобраны заново. Остальные узлы дерева
+// и объекты классов сохраняются. Тела методов разбираются сразу: параметры lazy_methods
+// и method_threads не действуют
+class IncrementalParser {
+public:
+    // Разбирает текст text. Ошибки разбора сообщает GetProgram
+    explicit IncrementalParser(std::string text, const ParseOptions& options = {});
+    ~IncrementalParser();
+
+    IncrementalParser(const IncrementalParser&) = delete;
+    IncrementalParser& operator=(const IncrementalParser&) = delete;
+
+    // Заменяет length байт текста, начиная с offset, текстом replacement и обновляет дерево.
+    // Объекты, созданные прежним исполнением программы, к этому моменту должны быть освобождены:
+    // они могут ссылаться на заменённые классы
+    void Edit(size_t offset, size_t length, std::string_view replacement);
+
+    [[nodiscard]] const std::string& GetText() const;
+
+    // Возвращает дерево программы. Если текст содержит ошибку, выбрасывает первую из них,
+    // как ParseProgram
+    [[nodiscard]] runtime::Executable& GetProgram();
+
+    // Возвращает количество частей текста, разобранных заново последней правкой или конструктором
+    [[nodiscard]] size_t GetReparsedCount() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
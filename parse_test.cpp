@@ -1,16 +1,28 @@
+#include "cache.h"
 #include "lexer.h"
 #include "parse.h"
 #include "statement.h"
 #include "test_runner_p.h"
 
+#include <random>
+
 using namespace std;
 
 namespace parse {
 
-unique_ptr<ast::Statement> ParseProgramFromString(const string& program) {
+unique_ptr<ast::Statement> ParseProgramFromString(const string& program, const ParseOptions& options = {}) {
     istringstream is(program);
     parse::Lexer lexer(is);
-    return ParseProgram(lexer);
+    return ParseProgram(lexer, options);
+}
+
+string Repeat(string_view text, size_t count) {
+    string result;
+    result.reserve(text.size() * count);
+    for (size_t i = 0; i < count; ++i) {
+        result += text;
+    }
+    return result;
 }
 
 void TestSimpleProgram() {
@@ -117,6 +129,91 @@ print x.calc(2)
     ASSERT_EQUAL(context.output.str(), "2\n"s);
 }
 
+void TestEarlyReturnFromNestedIf() {
+    const string program = R"(
+class Classifier:
+  def classify(n):
+    if n > 0:
+      if n > 100:
+        return "big"
+      print "not big", n
+      return "positive"
+    print "not positive", n
+    if n == 0:
+      return "zero"
+    return "negative"
+
+  def nothing():
+    print "nothing"
+
+c = Classifier()
+print c.classify(1000)
+print c.classify(5)
+print c.classify(0)
+print c.classify(-3)
+print c.nothing()
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(),
+                 "big\nnot big 5\npositive\nnot positive 0\nzero\nnot positive -3\nnegative\nnothing\nNone\n"s);
+}
+
+void TestReturnOutsideMethod() {
+    ASSERT_THROWS(ParseProgramFromString("print 1\nreturn 2\n"s), ParseError);
+    ASSERT_THROWS(ParseProgramFromString("if True:\n  return 2\n"s), ParseError);
+
+    // Класс, объявленный в теле метода, не завершает его разбор
+    const string program = R"(
+class Outer:
+  def make(n):
+    class Inner:
+      def get():
+        return 1
+    x = Inner()
+    return x.get() + n
+
+o = Outer()
+print o.make(2)
+)"s;
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "3\n"s);
+}
+
+void TestClassInMethod() {
+    // Класс, объявленный в теле метода, доступен по имени до конца тела
+    const string program = R"(
+class Factory:
+  def make(value):
+    x = 1
+    class Box:
+      def __init__(v):
+        self.v = v
+
+      def __str__():
+        return 'Box ' + str(self.v)
+    print Box
+    b = Box(value + x)
+    print b
+    return Box
+
+f = Factory()
+cls = f.make(2)
+print cls
+)"s;
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "Class Box\nBox 3\nClass Box\n"s);
+}
+
 void TestRecursion() {
     const string program = R"(
 class ArithmeticProgression:
@@ -191,6 +288,357 @@ print ok
     ASSERT_EQUAL(context.output.str(), "False\n"s);
 }
 
+void TestOperatorPrecedence() {
+    const string program = R"(
+print 2 + 3 * 4 - 10 / 2 / 5, (2 + 3) * 4, 10 - 4 - 3, -2 * 3 + - - 1
+print not 1 > 2 and 3 == 3, not not False or 2 < 1, (1 < 2) == True
+print 1 + 2 <= 3 and not 2 + 2 != 4 or 0
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "13 20 3 -5\nTrue False True\nTrue\n"s);
+
+    // Сравнения не объединяются в цепочки, not не может быть операндом арифметики и сравнения
+    for (const string& bad : {"print 1 < 2 < 3\n"s, "print 1 + not 2\n"s, "print 1 < not 2\n"s,
+                              "print not 1 < 2 < 3\n"s, "print 1 +\n"s}) {
+        ASSERT_THROWS(ParseProgramFromString(bad), parse::LexerError);
+    }
+}
+
+void TestDeepExpressions() {
+    // Цепочки не ограничены глубиной вложенности: ни длинные, ни заключённые в скобки
+    const size_t n = 5000;
+    const string program = "x = 2\n"s
+        + "print 0"s + Repeat(" + x - 1"sv, n) + "\n"s
+        + "print "s + string(n, '(') + "0"s + Repeat(" + 1)"sv, n) + "\n"s
+        + "print "s + Repeat("- "sv, n) + "7\n"s
+        + "print False"s + Repeat(" or x < 1"sv, n) + " or x == 2\n"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "5000\n5000\n7\nTrue\n"s);
+}
+
+void TestNestingLimits() {
+    const ParseOptions limits{10};
+    auto right_operands = [](size_t depth) {
+        return "print "s + Repeat("1 + (", depth) + "1"s + string(depth, ')') + "\n"s;
+    };
+    auto nots = [](size_t depth) {
+        return "print "s + Repeat("not ", depth) + "True\n"s;
+    };
+    auto calls = [](size_t depth) {
+        return "print "s + Repeat("str(", depth) + "1"s + string(depth, ')') + "\n"s;
+    };
+    auto blocks = [](size_t depth) {
+        string result;
+        for (size_t i = 0; i < depth; ++i) {
+            result += string(i * 2, ' ') + "if True:\n"s;
+        }
+        return result + string(depth * 2, ' ') + "print 1\n"s;
+    };
+
+    for (const auto& make : {+right_operands, +nots, +calls, +blocks}) {
+        ASSERT_DOESNT_THROW(ParseProgramFromString(make(limits.max_depth), limits));
+        ASSERT_THROWS(ParseProgramFromString(make(limits.max_depth + 1), limits), ParseError);
+    }
+    ASSERT_THROWS(ParseProgramFromString(right_operands(ParseOptions{}.max_depth + 1)), ParseError);
+}
+
+void TestLazyMethods() {
+    const string program = R"(
+class Shape:
+  def name():
+    return "sha" + 'pe'
+
+  def broken():
+    return Square(1)
+
+class Square(Shape):
+  def __init__(side):
+    self.side = side
+
+  def area():
+    if self.side > 0:
+      return self.side * self.side
+    return 0
+
+  def inner():
+    class Inner:
+      def value():
+        return 42
+    return Inner()
+
+s = Square(3)
+i = Inner()
+print s.area(), s.name(), i.value()
+)"s;
+
+    ParseOptions options;
+    options.lazy_methods = true;
+    auto tree = ParseProgramFromString(program, options);
+
+    const auto& statements = dynamic_cast<const ast::Compound&>(*tree).GetStatements();
+    auto methods = [&statements](size_t index) -> const vector<runtime::Method>& {
+        const auto& definition = dynamic_cast<const ast::ClassDefinition&>(*statements.at(index));
+        return definition.GetClass().TryAs<runtime::Class>()->GetMethods();
+    };
+    // Тела разбираются при первом вызове, кроме тела, объявляющего класс
+    const auto& shape = methods(0);
+    const auto& square = methods(1);
+    ASSERT(shape[0].source != nullptr && shape[0].body == nullptr);
+    ASSERT(square[2].source == nullptr && square[2].body != nullptr);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "9 shape 42\n"s);
+    ASSERT(shape[0].source == nullptr && shape[0].body != nullptr);
+    ASSERT(square[1].source == nullptr && square[1].frame_size == 1);
+    ASSERT(shape[1].source != nullptr);
+
+    // Тело видит только классы, объявленные до его класса, как и при разборе всей программы сразу
+    ASSERT_THROWS(ParseProgramFromString(program), ParseError);
+    ASSERT_THROWS(shape[1].Load(), ParseError);
+    ASSERT_THROWS(shape[1].Load(), ParseError);
+}
+
+void TestParallelMethods() {
+    string program;
+    for (int i = 0; i < 200; ++i) {
+        const string name = "C"s + to_string(i);
+        program += "class "s + name + (i > 0 ? "(C"s + to_string(i - 1) + ")"s : ""s) + ":\n"s
+            + "  def __init__(value):\n    self.value = value\n"s
+            + "  def get():\n    if self.value > "s + to_string(i) + ":\n      return 'big'\n"s
+            + "    return self.value * "s + to_string(i) + "\n"s
+            + "  def make():\n    return "s + (i > 0 ? "C"s + to_string(i - 1) + "(1)"s : "None"s) + "\n"s;
+    }
+    program += "x = C199(3)\ny = x.make()\nprint x.get(), y.get()\n"s;
+
+    ParseOptions parallel;
+    parallel.method_threads = 4;
+    auto sequential_tree = ParseProgramFromString(program);
+    auto parallel_tree = ParseProgramFromString(program, parallel);
+    // Деревья совпадают, если совпадает их сохранённое в кэше представление
+    const auto expected = cache::SaveProgram(*sequential_tree, program);
+    ASSERT(expected.has_value() && cache::SaveProgram(*parallel_tree, program) == expected);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    parallel_tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "597 198\n"s);
+
+    // Сообщается та же ошибка, что и при последовательном разборе: первая в тексте программы
+    auto error = [](const string& program, const ParseOptions& options) {
+        try {
+            ParseProgramFromString(program, options);
+        } catch (const exception& e) {
+            return string(e.what());
+        }
+        return "no error"s;
+    };
+    const string bad_bodies = "class A:\n  def f():\n    return B()\n  def g():\n    return str(1, 2)\n"s
+        + "class B:\n  def h():\n    return str()\n"s;
+    for (const string& bad : {bad_bodies, bad_bodies + "x = A(\n"s, "class A:\n  def f():\n    x = 1\nx = A(\n"s}) {
+        ASSERT_EQUAL(error(bad, parallel), error(bad, {}));
+    }
+    ASSERT_EQUAL(error(bad_bodies, parallel), "Unknown call to B()"s);
+}
+
+// Выполняет программу и возвращает её вывод, дополненный сообщением об ошибке исполнения
+string ExecuteProgram(runtime::Executable& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    try {
+        program.Execute(closure, context);
+    } catch (const exception& e) {
+        context.output << e.what();
+    }
+    return context.output.str();
+}
+
+// Сравнивает дерево, обновлённое правками, и его исполнение с деревом, заново разобранным из текста.
+// Возвращает вывод программы или сообщение об ошибке разбора
+string CheckIncremental(IncrementalParser& parser) {
+    const string& text = parser.GetText();
+    unique_ptr<ast::Statement> tree;
+    string expected_error;
+    try {
+        tree = ParseProgramFromString(text);
+    } catch (const exception& e) {
+        expected_error = e.what();
+    }
+    runtime::Executable* program = nullptr;
+    string error;
+    try {
+        program = &parser.GetProgram();
+    } catch (const exception& e) {
+        error = e.what();
+    }
+    ASSERT_EQUAL(error, expected_error);
+    if (!tree) {
+        return error;
+    }
+    const auto expected = cache::SaveProgram(*tree, text);
+    ASSERT(expected.has_value() && cache::SaveProgram(*program, text) == expected);
+    const string output = ExecuteProgram(*program);
+    ASSERT_EQUAL(output, ExecuteProgram(*tree));
+    return output;
+}
+
+// Заменяет первое вхождение what в тексте на replacement
+void EditText(IncrementalParser& parser, string_view what, string_view replacement) {
+    const size_t offset = parser.GetText().find(what);
+    ASSERT(offset != string::npos);
+    parser.Edit(offset, what.size(), replacement);
+}
+
+void TestIncrementalParser() {
+    IncrementalParser parser(R"(class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def sum():
+    return self.x + self.y
+
+class Point3(Point):
+  def __init__(x, y, z):
+    self.x = x
+    self.y = y
+    self.z = z
+
+# точки
+p = Point(1, 2)
+q = Point3(1, 2, 3)
+if p.sum() > 2:
+  print 'big'
+else:
+  print 'small'
+print q.sum()
+)"s);
+    ASSERT_EQUAL(CheckIncremental(parser), "big\n3\n"s);
+    ASSERT_EQUAL(parser.GetReparsedCount(), 6u);
+
+    // Правка инструкции разбирает заново только её
+    EditText(parser, "Point(1, 2)", "Point(0, 2)");
+    ASSERT_EQUAL(parser.GetReparsedCount(), 1u);
+    ASSERT_EQUAL(CheckIncremental(parser), "small\n3\n"s);
+
+    // Правка класса разбирает заново части, ссылающиеся на него и на его наследников
+    EditText(parser, "self.x + self.y", "self.x * self.y");
+    ASSERT_EQUAL(parser.GetReparsedCount(), 4u);
+    ASSERT_EQUAL(CheckIncremental(parser), "small\n2\n"s);
+
+    // Ошибка и её исправление
+    EditText(parser, "Point(0, 2)", "Pointt(0, 2)");
+    ASSERT_EQUAL(CheckIncremental(parser), "Unknown call to Pointt()"s);
+    EditText(parser, "Pointt(0, 2)", "Point(3, 2)");
+    ASSERT_EQUAL(parser.GetReparsedCount(), 1u);
+    ASSERT_EQUAL(CheckIncremental(parser), "big\n2\n"s);
+
+    // Разделение и слияние строк
+    EditText(parser, "q = ", "r = Point(2, 2)\nprint r.sum()\nq = ");
+    ASSERT_EQUAL(CheckIncremental(parser), "4\nbig\n2\n"s);
+    EditText(parser, "print r.sum()\n", "print r.sum() ");
+    CheckIncremental(parser);
+    EditText(parser, "print r.sum() ", "");
+    ASSERT_EQUAL(CheckIncremental(parser), "big\n2\n"s);
+
+    // Строка с отступом присоединяется к ветке else, ветка else отделяется от if
+    EditText(parser, "print q.sum()", "  print q.sum()");
+    ASSERT_EQUAL(CheckIncremental(parser), "big\n"s);
+    EditText(parser, "if p.sum() > 2:", "x = p.sum() > 2");
+    CheckIncremental(parser);
+    EditText(parser, "x = p.sum() > 2", "if p.sum() > 2:");
+    EditText(parser, "  print q.sum()", "print q.sum()");
+    ASSERT_EQUAL(CheckIncremental(parser), "big\n2\n"s);
+
+    // Переименование и удаление классов, повторное объявление
+    EditText(parser, "class Point:", "class Pt:");
+    CheckIncremental(parser);
+    EditText(parser, "class Pt:", "class Point:");
+    ASSERT_EQUAL(CheckIncremental(parser), "big\n2\n"s);
+    EditText(parser, "class Point3(Point):", "class Point(Point):");
+    CheckIncremental(parser);
+    EditText(parser, "class Point(Point):", "class Point3(Point):");
+    parser.Edit(0, parser.GetText().find("class Point3"), "");
+    CheckIncremental(parser);
+    parser.Edit(0, 0, "class Point:\n  def sum():\n    return 5\n");
+    ASSERT_EQUAL(CheckIncremental(parser), "big\n5\n"s);
+
+    // Кэши вызовов в сохранённых узлах не находят методы заменённых классов. Заменённые классы
+    // освобождаются полным разбором, когда их становится много
+    for (int i = 6; i < 100; ++i) {
+        EditText(parser, "return "s + to_string(i - 1), "return "s + to_string(i));
+        ASSERT_EQUAL(CheckIncremental(parser), "big\n"s + to_string(i) + "\n"s);
+    }
+
+    // Текст без завершающего перевода строки
+    parser.Edit(parser.GetText().size() - 1, 1, "");
+    CheckIncremental(parser);
+    parser.Edit(0, parser.GetText().size(), "print 1");
+    ASSERT_EQUAL(CheckIncremental(parser), "1\n"s);
+    parser.Edit(0, 0, "\n# 1\n");
+    ASSERT_EQUAL(CheckIncremental(parser), "1\n"s);
+    parser.Edit(0, 0, "x = 2\n");
+    CheckIncremental(parser);
+    parser.Edit(0, 6, "");
+    ASSERT_EQUAL(CheckIncremental(parser), "1\n"s);
+    ASSERT_THROWS(parser.Edit(parser.GetText().size(), 1, ""), out_of_range);
+
+    // Случайные правки: строки добавляются и удаляются целиком, а правки отдельных символов
+    // сразу отменяются, поэтому текст часто остаётся правильной программой
+    const vector<string> lines = {
+        "class A:\n  def f():\n    return 1\n"s, "class B(A):\n  def g():\n    return self.f() + 1\n"s,
+        "class A:\n  def f():\n    return 'a'\n"s, "x = A()\n"s, "y = B()\n"s, "x = None\n"s,
+        "if x.f() == 1:\n  print x.f()\nelse:\n  print 0\n"s, "print y.g(), x\n"s, "else:\n  print 2\n"s,
+        "  print 3\n"s, "\n"s, "# A\n"s,
+    };
+    const vector<string> symbols = {""s, "\n"s, "  "s, "#"s, ")"s, ":"s, "A"s, "else"s};
+    mt19937 generator(42);
+    auto line_start = [&generator](const string& text) {
+        const size_t offset = generator() % (text.size() + 1);
+        const size_t newline = offset == 0 ? string::npos : text.rfind('\n', offset - 1);
+        return newline == string::npos ? 0 : newline + 1;
+    };
+    parser.Edit(0, parser.GetText().size(), "");
+    for (int i = 0; i < 300; ++i) {
+        const string text = parser.GetText();
+        const size_t offset = line_start(text);
+        switch (generator() % 3) {
+            case 0:
+                parser.Edit(offset, 0, lines[generator() % lines.size()]);
+                break;
+            case 1: {
+                const size_t end = text.find('\n', offset);
+                parser.Edit(offset, (end == string::npos ? text.size() : end + 1) - offset, "");
+                break;
+            }
+            default: {
+                const size_t symbol_offset = generator() % (text.size() + 1);
+                const size_t length = generator() % 2 == 0 && symbol_offset < text.size() ? 1 : 0;
+                const string& symbol = symbols[generator() % symbols.size()];
+                parser.Edit(symbol_offset, length, symbol);
+                CheckIncremental(parser);
+                parser.Edit(symbol_offset, symbol.size(), text.substr(symbol_offset, length));
+                ASSERT_EQUAL(parser.GetText(), text);
+            }
+        }
+        CheckIncremental(parser);
+    }
+}
+
 void TestClassicalPolymorphism() {
     const string program = R"(
 class Shape:
@@ -251,8 +699,17 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestProgramWithClasses);
     RUN_TEST(tr, parse::TestProgramWithIf);
     RUN_TEST(tr, parse::TestReturnFromIf);
+    RUN_TEST(tr, parse::TestEarlyReturnFromNestedIf);
+    RUN_TEST(tr, parse::TestReturnOutsideMethod);
+    RUN_TEST(tr, parse::TestClassInMethod);
     RUN_TEST(tr, parse::TestRecursion);
     RUN_TEST(tr, parse::TestRecursion2);
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
+    RUN_TEST(tr, parse::TestOperatorPrecedence);
+    RUN_TEST(tr, parse::TestDeepExpressions);
+    RUN_TEST(tr, parse::TestNestingLimits);
+    RUN_TEST(tr, parse::TestLazyMethods);
+    RUN_TEST(tr, parse::TestParallelMethods);
+    RUN_TEST(tr, parse::TestIncrementalParser);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
 }
\ No newline at end of file
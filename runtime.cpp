@@ -1,21 +1,114 @@
 #include "runtime.h"
 
+#include <deque>
+#include <limits>
 
 using namespace std;
 
 namespace runtime {
 
-	ObjectHolder::ObjectHolder(std::shared_ptr<Object> data)
-		: data_(std::move(data)) {
+	ObjectHolder::ObjectHolder(const ObjectHolder& other) {
+		CopyFrom(other);
 	}
 
-	void ObjectHolder::AssertIsValid() const {
-		assert(data_ != nullptr);
+	ObjectHolder::ObjectHolder(ObjectHolder&& other) noexcept {
+		MoveFrom(other);
+	}
+
+	ObjectHolder& ObjectHolder::operator=(const ObjectHolder& other) {
+		if (this != &other) {
+			// other может принадлежать объекту, который удалится вместе с текущим значением
+			ObjectHolder copy(other);
+			Reset();
+			MoveFrom(copy);
+		}
+		return *this;
+	}
+
+	ObjectHolder& ObjectHolder::operator=(ObjectHolder&& other) noexcept {
+		if (this != &other) {
+			ObjectHolder moved(std::move(other));
+			Reset();
+			MoveFrom(moved);
+		}
+		return *this;
+	}
+
+	ObjectHolder::~ObjectHolder() {
+		Reset();
+	}
+
+	void ObjectHolder::CopyFrom(const ObjectHolder& other) {
+		switch (other.tag_) {
+		case Tag::Heap:
+			other.StoredPointer()->ref_count_.Increment();
+			new (storage_) Object*(other.StoredPointer());
+			break;
+		case Tag::Borrowed:
+			new (storage_) Object*(other.StoredPointer());
+			break;
+		case Tag::Number:
+			new (storage_) Number(*other.InlineObject<Number>());
+			break;
+		case Tag::Bool:
+			new (storage_) Bool(*other.InlineObject<Bool>());
+			break;
+		case Tag::Empty:
+			break;
+		}
+		tag_ = other.tag_;
+	}
+
+	void ObjectHolder::MoveFrom(ObjectHolder& other) noexcept {
+		if (other.tag_ == Tag::Heap) {
+			// Владение передаётся без изменения счётчика ссылок
+			new (storage_) Object*(other.StoredPointer());
+			tag_ = Tag::Heap;
+			other.tag_ = Tag::Empty;
+		}
+		else {
+			CopyFrom(other);
+			other.Reset();
+		}
+	}
+
+	void ObjectHolder::Reset() noexcept {
+		switch (tag_) {
+		case Tag::Heap:
+			if (Object* object = StoredPointer(); object->ref_count_.Decrement()) {
+				// Деструктор объекта может освободить другие ObjectHolder, в том числе
+				// владеющий этим, поэтому он вызывается после сброса состояния
+				tag_ = Tag::Empty;
+				delete object;
+				return;
+			}
+			break;
+		case Tag::Number:
+			InlineObject<Number>()->~Number();
+			break;
+		case Tag::Bool:
+			InlineObject<Bool>()->~Bool();
+			break;
+		case Tag::Borrowed:
+		case Tag::Empty:
+			break;
+		}
+		tag_ = Tag::Empty;
 	}
 
 	ObjectHolder ObjectHolder::Share(Object& object) {
-		// Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-		return ObjectHolder(std::shared_ptr<Object>(&object, [](auto* /*p*/) { /* do nothing */ }));
+		// Объект в куче, созданный Own, не должен пережить ссылку на него: например, self временного
+		// объекта, возвращённый методом. Невладеющая ссылка хранится как обычный указатель
+		ObjectHolder result;
+		new (result.storage_) Object*(&object);
+		if (object.ref_count_.HasOwners()) {
+			object.ref_count_.Increment();
+			result.tag_ = Tag::Heap;
+		}
+		else {
+			result.tag_ = Tag::Borrowed;
+		}
+		return result;
 	}
 
 	ObjectHolder ObjectHolder::None() {
@@ -23,42 +116,56 @@ namespace runtime {
 	}
 
 	Object& ObjectHolder::operator*() const {
-		AssertIsValid();
+		assert(tag_ != Tag::Empty);
 		return *Get();
 	}
 
 	Object* ObjectHolder::operator->() const {
-		AssertIsValid();
+		assert(tag_ != Tag::Empty);
 		return Get();
 	}
 
-	Object* ObjectHolder::Get() const {
-		return data_.get();
+	Frame::Frame(size_t size)
+		: slots_(size)
+	{
 	}
 
-	ObjectHolder::operator bool() const {
-		return Get() != nullptr;
+	ObjectHolder* Frame::Find(size_t slot) {
+		Slot& s = slots_[slot];
+		return s.bound ? &s.value : nullptr;
 	}
 
-	bool IsTrue(const ObjectHolder& object) {
+	ObjectHolder& Frame::Assign(size_t slot, ObjectHolder value) {
+		Slot& s = slots_[slot];
+		s.value = std::move(value);
+		s.bound = true;
+		return s.value;
+	}
 
-		Bool* is_bool = object.TryAs<Bool>();
-		if (is_bool)
-		{
-			return is_bool->GetValue();
-		}
+	size_t Frame::Size() const {
+		return slots_.size();
+	}
 
-		Number* is_number = object.TryAs<Number>();
-		if (is_number) {
-			return !(is_number->GetValue() == 0);
+	Context::CallGuard::CallGuard(Context& context)
+		: context_(context)
+	{
+		if (context.call_depth_ >= context.max_call_depth_) {
+			throw runtime_error("Maximum call depth of "s + to_string(context.max_call_depth_) + " exceeded"s);
 		}
+		++context.call_depth_;
+	}
 
-		String* is_string = object.TryAs<String>();
-		if (is_string) {
-			return !(is_string->GetValue().empty());
+	bool IsTrue(const ObjectHolder& object) {
+		switch (object.GetType()) {
+		case ObjectType::Bool:
+			return object.TryAs<Bool>()->GetValue();
+		case ObjectType::Number:
+			return object.TryAs<Number>()->GetValue() != 0;
+		case ObjectType::String:
+			return !object.TryAs<String>()->GetValue().empty();
+		default:
+			return false;
 		}
-
-		return false;
 	}
 
 
@@ -68,15 +175,15 @@ namespace runtime {
 
 
 	void ClassInstance::Print(std::ostream& os, Context& context) {
-		if (HasMethod(STR_METHOD, 0U)) {
-			Call(STR_METHOD, {}, context)->Print(os, context);
+		if (HasMethod(SpecialMethod::Str, 0U)) {
+			Call(SpecialMethod::Str, {}, context)->Print(os, context);
 		}
 		else {
 			os << this;
 		}
 	}
 
-	bool ClassInstance::HasMethod(const std::string& method, size_t argument_count) const {
+	bool ClassInstance::HasMethod(Symbol method, size_t argument_count) const {
 		const Method* mt = class_.GetMethod(method);
 		if (mt != nullptr) {
 			return mt->formal_params.size() == argument_count;
@@ -84,77 +191,251 @@ namespace runtime {
 		return false;
 	}
 
+	bool ClassInstance::HasMethod(SpecialMethod method, size_t argument_count) const {
+		const Method* mt = class_.GetMethod(method);
+		return mt != nullptr && mt->formal_params.size() == argument_count;
+	}
+
 	Closure& ClassInstance::Fields() {
-		return closure_;
+		return ToDictionary();
 	}
 
 	const Closure& ClassInstance::Fields() const {
-		return closure_;
+		return ToDictionary();
+	}
+
+	Closure& ClassInstance::ToDictionary() const {
+		if (shape_ != nullptr) {
+			dictionary_ = make_unique<Closure>();
+			const vector<Symbol>& names = shape_->GetFieldNames();
+			for (size_t i = 0; i < names.size(); ++i) {
+				dictionary_->emplace(names[i], move(fields_[i]));
+			}
+			fields_.clear();
+			fields_.shrink_to_fit();
+			shape_ = nullptr;
+		}
+		return *dictionary_;
+	}
+
+	ObjectHolder* ClassInstance::FindField(Symbol name) {
+		if (shape_ == nullptr) {
+			auto it = dictionary_->find(name);
+			return it != dictionary_->end() ? &it->second : nullptr;
+		}
+		size_t offset = shape_->Find(name);
+		return offset != Shape::NO_FIELD ? &fields_[offset] : nullptr;
+	}
+
+	ObjectHolder* ClassInstance::FindField(Symbol name, FieldCache& cache) {
+		if (shape_ != nullptr && shape_ == cache.shape && cache.transition == nullptr) {
+			return &fields_[cache.offset];
+		}
+		ObjectHolder* field = FindField(name);
+		if (field != nullptr && shape_ != nullptr) {
+			cache = { shape_, nullptr, static_cast<size_t>(field - fields_.data()) };
+		}
+		return field;
+	}
+
+	ObjectHolder& ClassInstance::SetField(Symbol name, ObjectHolder value) {
+		if (ObjectHolder* field = FindField(name)) {
+			return *field = move(value);
+		}
+		if (shape_ != nullptr) {
+			if (const Shape* next = shape_->AddField(name)) {
+				shape_ = next;
+				fields_.push_back(move(value));
+				class_.instance_size_ = max(class_.instance_size_, fields_.size());
+				return fields_.back();
+			}
+			ToDictionary();
+		}
+		return (*dictionary_)[name] = move(value);
+	}
+
+	ObjectHolder& ClassInstance::SetField(Symbol name, ObjectHolder value, FieldCache& cache) {
+		if (shape_ != nullptr && shape_ == cache.shape) {
+			if (cache.transition == nullptr) {
+				return fields_[cache.offset] = move(value);
+			}
+			shape_ = cache.transition;
+			fields_.push_back(move(value));
+			class_.instance_size_ = max(class_.instance_size_, fields_.size());
+			return fields_.back();
+		}
+
+		const Shape* before = shape_;
+		ObjectHolder& field = SetField(name, move(value));
+		if (before != nullptr && shape_ != nullptr) {
+			size_t offset = static_cast<size_t>(&field - fields_.data());
+			cache = { before, before != shape_ ? shape_ : nullptr, offset };
+		}
+		return field;
+	}
+
+	const Class& ClassInstance::GetClass() const {
+		return class_;
 	}
 
 	ClassInstance::ClassInstance(const Class& cls)
-		: class_(cls)
+		: Object(ObjectType::ClassInstance)
+		, class_(cls)
+		, shape_(&cls.root_shape_)
 	{
+		fields_.reserve(cls.instance_size_);
+	}
+
+	size_t Shape::Find(Symbol name) const {
+		auto it = offsets_.find(name);
+		return it != offsets_.end() ? it->second : NO_FIELD;
 	}
 
-	ObjectHolder ClassInstance::Call(const std::string& method,
+	const Shape* Shape::AddField(Symbol name) const {
+		auto it = transitions_.find(name);
+		if (it != transitions_.end()) {
+			return it->second.get();
+		}
+		if (names_.size() >= MAX_FIELDS) {
+			return nullptr;
+		}
+
+		auto next = make_unique<Shape>();
+		next->names_ = names_;
+		next->names_.push_back(name);
+		next->offsets_ = offsets_;
+		next->offsets_.emplace(name, names_.size());
+		return transitions_.emplace(name, move(next)).first->second.get();
+	}
+
+	ObjectHolder ClassInstance::Call(Symbol method,
 		const std::vector<ObjectHolder>& actual_args,
 		Context& context) {
 
 		const Method* mt = class_.GetMethod(method);
 
 		if (mt != nullptr && mt->formal_params.size() == actual_args.size()) {
-			Closure args;
-			args["self"s] = ObjectHolder::Share(*this);
+			return Call(*mt, actual_args, context);
+		}
 
-			size_t arg_index = 0;
-			for (auto& param : mt->formal_params) {
-				args[param] = actual_args.at(arg_index++);
-			}
+		throw std::runtime_error("Not implemented"s);
+	}
 
-			return mt->body->Execute(args, context);
+	ObjectHolder ClassInstance::Call(SpecialMethod method,
+		const std::vector<ObjectHolder>& actual_args,
+		Context& context) {
+
+		const Method* mt = class_.GetMethod(method);
+
+		if (mt != nullptr && mt->formal_params.size() == actual_args.size()) {
+			return Call(*mt, actual_args, context);
 		}
 
 		throw std::runtime_error("Not implemented"s);
 	}
 
+	ObjectHolder ClassInstance::Call(const Method& method,
+		const std::vector<ObjectHolder>& actual_args,
+		Context& context) {
+
+		Context::CallGuard guard(context);
+		method.Load();
+		if (method.frame_size > 0) {
+			Frame frame(method.frame_size);
+			frame.Assign(0, ObjectHolder::Share(*this));
+			for (size_t i = 0; i < actual_args.size(); ++i) {
+				frame.Assign(i + 1, actual_args[i]);
+			}
+
+			Closure args(frame);
+			return method.body->Execute(args, context);
+		}
+
+		Closure args;
+		args[SELF] = ObjectHolder::Share(*this);
+
+		size_t arg_index = 0;
+		for (auto& param : method.formal_params) {
+			args[param] = actual_args.at(arg_index++);
+		}
+
+		return method.body->Execute(args, context);
+	}
 
 
 
 
 
 
-	Class::Class(std::string name, std::vector<Method> methods, const Class* parent)
-		: parent_(parent)
-		, name_(move(name))
+
+
+	const std::string& GetSpecialMethodName(SpecialMethod method) {
+		switch (method) {
+		case SpecialMethod::Init:
+			return INIT_METHOD;
+		case SpecialMethod::Str:
+			return STR_METHOD;
+		case SpecialMethod::Eq:
+			return EQ_METHOD;
+		case SpecialMethod::Less:
+			return LESS_METHOD;
+		case SpecialMethod::Add:
+			return ADD_METHOD;
+		}
+		throw std::logic_error("Unknown special method"s);
+	}
+
+	Class::Class(Symbol name, std::vector<Method> methods, const Class* parent)
+		: Object(ObjectType::Class)
+		, parent_(parent)
+		, name_(name)
 		, methods_(move(methods))
 	{
-		// Все методы проиндексируем указателями, для ускорения поиска нужных методов
+		method_table_.reserve(methods_.size());
 		for (Method& mt : methods_) {
-			vt_methods_[mt.name] = &mt;
+			if (mt.id == NO_METHOD_ID) {
+				mt.id = InternMethodName(mt.name);
+			}
+			method_table_.push_back(&mt);
+		}
+		// Из одноимённых методов класса действует объявленный последним
+		const auto by_id = [](const Method* lhs, const Method* rhs) {
+			return lhs->id < rhs->id;
+		};
+		std::stable_sort(method_table_.begin(), method_table_.end(), by_id);
+		for (auto it = method_table_.begin(); it != method_table_.end();) {
+			auto same = std::upper_bound(it, method_table_.end(), *it, by_id);
+			it = method_table_.erase(it, same - 1) + 1;
 		}
 
-	}
-
-	const Method* Class::GetMethod(const std::string& name) const {
-		// Сначала ищем методы в текущем классе
-		auto it = vt_methods_.find(name);
-		if (it != vt_methods_.end()) {
-			return it->second;
+		for (size_t i = 0; i < SPECIAL_METHOD_COUNT; ++i) {
+			const Method* own = FindOwnMethod(FindMethodId(GetSpecialMethodName(static_cast<SpecialMethod>(i))));
+			special_methods_[i] = own != nullptr || parent_ == nullptr ? own : parent_->special_methods_[i];
 		}
+	}
 
-		// Когда нужного метода нет - ищем в родительском
-		if (parent_) {
-			auto itP = parent_->vt_methods_.find(name);
-			if (itP != parent_->vt_methods_.end()) {
-				return itP->second;
+	const Method* Class::GetMethod(MethodId id) const {
+		for (const Class* cls = this; cls != nullptr; cls = cls->parent_) {
+			if (const Method* method = cls->FindOwnMethod(id)) {
+				return method;
 			}
 		}
 		return nullptr;
 	}
 
+	const Method* Class::FindOwnMethod(MethodId id) const {
+		auto it = std::lower_bound(method_table_.begin(), method_table_.end(), id, [](const Method* method, MethodId value) {
+			return method->id < value;
+		});
+		return it != method_table_.end() && (*it)->id == id ? *it : nullptr;
+	}
+
+	const Method* Class::GetMethod(Symbol name) const {
+		return GetMethod(FindMethodId(name));
+	}
+
 	[[nodiscard]] const std::string& Class::GetName() const {
-		return name_;
+		return name_.Name();
 	}
 
 	void Class::Print(ostream& os, [[maybe_unused]] Context& context) {
@@ -174,40 +455,146 @@ namespace runtime {
 
 
 
-	bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-		// Если lhs - объект с методом __eq__, функция возвращает результат вызова lhs.__eq__(rhs)
-		auto lhs_is_class = lhs.TryAs<ClassInstance>();
-		if (lhs_is_class) {
-			return IsTrue(lhs_is_class->Call(EQ_METHOD, { rhs }, context));
+	namespace {
+		// Операция над парой объектов, типы которых заданы положением операции в таблице
+		using CompareOperation = bool (*)(const ObjectHolder&, const ObjectHolder&, Context&);
+		using BinaryOperation = ObjectHolder(*)(const ObjectHolder&, const ObjectHolder&, Context&);
+
+		template <typename T, typename Predicate>
+		bool CompareValues(const ObjectHolder& lhs, const ObjectHolder& rhs, [[maybe_unused]] Context& context) {
+			return Predicate()(lhs.TryAs<T>()->GetValue(), rhs.TryAs<T>()->GetValue());
 		}
 
-		optional<bool> result = Comparator(lhs, rhs, std::equal_to());
-		if (result) {
-			return result.value();
+		template <typename T>
+		ObjectHolder AddValues(const ObjectHolder& lhs, const ObjectHolder& rhs, [[maybe_unused]] Context& context) {
+			if constexpr (std::is_same_v<T, Number>) {
+				return ObjectHolder::Own(Number(AddNumbers(lhs.TryAs<Number>()->GetValue(), rhs.TryAs<Number>()->GetValue())));
+			}
+			else {
+				return ObjectHolder::Own(T(lhs.TryAs<T>()->GetValue() + rhs.TryAs<T>()->GetValue()));
+			}
+		}
+
+		// Результат вызова специального метода method у объекта lhs
+		template <SpecialMethod method>
+		ObjectHolder CallMethod(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+			return lhs.TryAs<ClassInstance>()->Call(method, { rhs }, context);
+		}
+
+		template <SpecialMethod method>
+		bool CallPredicate(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+			return IsTrue(CallMethod<method>(lhs, rhs, context));
 		}
 
-		if (lhs.Get() == nullptr && rhs.Get() == nullptr) {
-			return true;
+		constexpr size_t Index(ObjectType type) {
+			return static_cast<size_t>(type);
 		}
 
+		// Заполняет таблицу сравнения: встроенные значения сравниваются предикатом Predicate,
+		// объекты пользовательских классов - специальным методом method
+		template <typename Predicate, SpecialMethod method>
+		constexpr DispatchTable<CompareOperation> MakeCompareTable() {
+			DispatchTable<CompareOperation> table{};
+			for (size_t rhs = 0; rhs < DISPATCH_TYPE_COUNT; ++rhs) {
+				table[Index(ObjectType::ClassInstance)][rhs] = &CallPredicate<method>;
+			}
+			table[Index(ObjectType::Number)][Index(ObjectType::Number)] = &CompareValues<Number, Predicate>;
+			table[Index(ObjectType::String)][Index(ObjectType::String)] = &CompareValues<String, Predicate>;
+			table[Index(ObjectType::Bool)][Index(ObjectType::Bool)] = &CompareValues<Bool, Predicate>;
+			return table;
+		}
+
+		constexpr DispatchTable<CompareOperation> MakeEqualTable() {
+			DispatchTable<CompareOperation> table = MakeCompareTable<std::equal_to<>, SpecialMethod::Eq>();
+			table[Index(ObjectType::None)][Index(ObjectType::None)] =
+				[](const ObjectHolder&, const ObjectHolder&, Context&) {
+					return true;
+				};
+			return table;
+		}
+
+		constexpr DispatchTable<BinaryOperation> MakeAddTable() {
+			DispatchTable<BinaryOperation> table{};
+			for (size_t rhs = 0; rhs < DISPATCH_TYPE_COUNT; ++rhs) {
+				table[Index(ObjectType::ClassInstance)][rhs] = &CallMethod<SpecialMethod::Add>;
+			}
+			table[Index(ObjectType::Number)][Index(ObjectType::Number)] = &AddValues<Number>;
+			table[Index(ObjectType::String)][Index(ObjectType::String)] = &AddValues<String>;
+			return table;
+		}
+
+		// Пустая ячейка таблицы означает, что операция для данной пары типов не определена
+		constexpr DispatchTable<CompareOperation> EQUAL_TABLE = MakeEqualTable();
+		constexpr DispatchTable<CompareOperation> LESS_TABLE = MakeCompareTable<std::less<>, SpecialMethod::Less>();
+		constexpr DispatchTable<BinaryOperation> ADD_TABLE = MakeAddTable();
+
+		template <typename Operation>
+		Operation Lookup(const DispatchTable<Operation>& table, const ObjectHolder& lhs, const ObjectHolder& rhs) {
+			return table[DispatchIndex(lhs.GetType())][DispatchIndex(rhs.GetType())];
+		}
+	}  // namespace
+
+	bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+		if (CompareOperation equal = Lookup(EQUAL_TABLE, lhs, rhs)) {
+			return equal(lhs, rhs, context);
+		}
 		throw std::runtime_error("Cannot compare objects for equality"s);
 	}
 
 	bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-		// Если первый аргумент — объект пользовательского класса с методом __lt__, 
-		// функция возвращает результат вызова lhs.__lt__(rhs), приведённый к типу Bool
+		if (CompareOperation less = Lookup(LESS_TABLE, lhs, rhs)) {
+			return less(lhs, rhs, context);
+		}
+		throw std::runtime_error("Cannot compare objects for less"s);
+	}
 
-		auto lhs_is_class = lhs.TryAs<ClassInstance>();
-		if (lhs_is_class) {
-			return IsTrue(lhs_is_class->Call(LESS_METHOD, { rhs }, context));
+	ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+		if (BinaryOperation add = Lookup(ADD_TABLE, lhs, rhs)) {
+			return add(lhs, rhs, context);
 		}
+		throw std::runtime_error("Cannot execute binary operation"s);
+	}
 
-		optional<bool> result = Comparator(lhs, rhs, std::less());
-		if (result) {
-			return result.value();
+	namespace {
+		[[noreturn]] void ThrowOverflow() {
+			throw std::runtime_error("Integer overflow"s);
 		}
+	}  // namespace
 
-		throw std::runtime_error("Cannot compare objects for less"s);
+	std::int64_t AddNumbers(std::int64_t lhs, std::int64_t rhs) {
+		std::int64_t result;
+		if (__builtin_add_overflow(lhs, rhs, &result)) {
+			ThrowOverflow();
+		}
+		return result;
+	}
+
+	std::int64_t SubtractNumbers(std::int64_t lhs, std::int64_t rhs) {
+		std::int64_t result;
+		if (__builtin_sub_overflow(lhs, rhs, &result)) {
+			ThrowOverflow();
+		}
+		return result;
+	}
+
+	std::int64_t MultiplyNumbers(std::int64_t lhs, std::int64_t rhs) {
+		std::int64_t result;
+		if (__builtin_mul_overflow(lhs, rhs, &result)) {
+			ThrowOverflow();
+		}
+		return result;
+	}
+
+	std::int64_t DivideNumbers(std::int64_t lhs, std::int64_t rhs) {
+		// Целочисленное деление на 0 завершает процесс сигналом, а не исключением
+		if (rhs == 0) {
+			throw std::runtime_error("Division by 0"s);
+		}
+		// Частное INT64_MIN / -1 не представимо
+		if (rhs == -1 && lhs == std::numeric_limits<std::int64_t>::min()) {
+			ThrowOverflow();
+		}
+		return lhs / rhs;
 	}
 
 	bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
@@ -1,6 +1,14 @@
 #pragma once
 
+#include "symbol.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <new>
+#include <type_traits>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -15,17 +23,127 @@ namespace runtime {
     const std::string STR_METHOD = "__str__"s;
     const std::string EQ_METHOD = "__eq__"s;
     const std::string LESS_METHOD = "__lt__"s;
+    const std::string ADD_METHOD = "__add__"s;
+    const std::string INIT_METHOD = "__init__"s;
+
+    // Имя, под которым метод видит объект, у которого он вызван
+    inline const Symbol SELF{"self"};
+
+    // Специальные методы, которые класс находит заранее и хранит в отдельной таблице,
+    // чтобы операторы над объектами не искали их по имени
+    enum class SpecialMethod : std::uint8_t {
+        Init,
+        Str,
+        Eq,
+        Less,
+        Add,
+    };
+
+    inline constexpr size_t SPECIAL_METHOD_COUNT = static_cast<size_t>(SpecialMethod::Add) + 1;
+
+    // Возвращает имя специального метода
+    [[nodiscard]] const std::string& GetSpecialMethodName(SpecialMethod method);
 
     // Контекст исполнения инструкций Mython
     class Context {
     public:
+        static constexpr size_t DEFAULT_MAX_CALL_DEPTH = 1000;
+
+        // Учитывает вызов метода, пока существует. Вызов, превышающий наибольшую глубину вложенных
+        // вызовов, завершается исключением runtime_error, а не переполнением стека
+        class CallGuard {
+        public:
+            explicit CallGuard(Context& context);
+            ~CallGuard() {
+                --context_.call_depth_;
+            }
+
+            CallGuard(const CallGuard&) = delete;
+            CallGuard& operator=(const CallGuard&) = delete;
+
+        private:
+            Context& context_;
+        };
+
         // Возвращает поток вывода для команд print
         virtual std::ostream& GetOutputStream() = 0;
 
+        [[nodiscard]] size_t GetMaxCallDepth() const {
+            return max_call_depth_;
+        }
+
+        void SetMaxCallDepth(size_t depth) {
+            max_call_depth_ = depth;
+        }
+
     protected:
         ~Context() = default;
+
+    private:
+        size_t max_call_depth_ = DEFAULT_MAX_CALL_DEPTH;
+        size_t call_depth_ = 0;
+    };
+
+
+    // Счётчик ссылок на объект. Интерпретатор однопоточный, поэтому по умолчанию счётчик
+    // не атомарный. Сборка с MYTHON_ATOMIC_REFCOUNT позволяет владеть объектами из разных потоков
+    class RefCount {
+    public:
+        RefCount() = default;
+        // Копия объекта - новый объект, ссылки на оригинал к ней не относятся
+        RefCount(const RefCount& /*other*/) noexcept {
+        }
+        RefCount& operator=(const RefCount& /*other*/) noexcept {
+            return *this;
+        }
+
+        void Increment() noexcept {
+            ++count_;
+        }
+
+        // Уменьшает счётчик и возвращает true, если ссылок на объект не осталось
+        [[nodiscard]] bool Decrement() noexcept {
+            return --count_ == 0;
+        }
+
+        // Возвращает true, если объектом владеет хотя бы один ObjectHolder
+        [[nodiscard]] bool HasOwners() const noexcept {
+            return count_ != 0;
+        }
+
+    private:
+#ifdef MYTHON_ATOMIC_REFCOUNT
+        std::atomic<std::uint32_t> count_ = 0;
+#else
+        std::uint32_t count_ = 0;
+#endif
+    };
+
+    // Тип объекта. По нему операции над значениями выбираются без обращения к RTTI.
+    // Объекты, не относящиеся к встроенным типам, имеют тип Other либо тип из диапазона
+    // [FirstCustom, 255], который расширения назначают своим классам самостоятельно
+    enum class ObjectType : std::uint8_t {
+        None,           // пустой ObjectHolder
+        Number,
+        String,
+        Bool,
+        Class,
+        ClassInstance,
+        Other,
+        FirstCustom = 32,
     };
 
+    // Количество строк и столбцов таблиц диспетчеризации бинарных операций.
+    // Все типы, начиная с Other, попадают в последнюю строку (столбец)
+    inline constexpr size_t DISPATCH_TYPE_COUNT = static_cast<size_t>(ObjectType::Other) + 1;
+
+    [[nodiscard]] constexpr size_t DispatchIndex(ObjectType type) {
+        return std::min(static_cast<size_t>(type), DISPATCH_TYPE_COUNT - 1);
+    }
+
+    // Таблица, хранящая значение типа T для каждой пары (тип lhs, тип rhs)
+    template <typename T>
+    using DispatchTable = std::array<std::array<T, DISPATCH_TYPE_COUNT>, DISPATCH_TYPE_COUNT>;
 
     // Базовый класс для всех объектов языка Mython
     class Object {
@@ -33,26 +151,148 @@ namespace runtime {
         virtual ~Object() = default;
         // выводит в os своё представление в виде строки
         virtual void Print(std::ostream& os, Context& context) = 0;
+
+        [[nodiscard]] ObjectType GetType() const {
+            return type_;
+        }
+
+    protected:
+        Object() = default;
+        // Тип объекта должен соответствовать его классу: объект встроенного типа обязан
+        // быть экземпляром соответствующего класса или его наследника
+        explicit Object(ObjectType type)
+            : type_(type) {
+        }
+
+    private:
+        friend class ObjectHolder;
+
+        // Количество владеющих объектом ObjectHolder
+        RefCount ref_count_;
+        ObjectType type_ = ObjectType::Other;
+    };
+
+
+
+
+    // Объект-значение, хранящий значение типа T
+    template <typename T>
+    class ValueObject : public Object {
+    public:
+        ValueObject(T v)  
+            : Object(TypeOf())
+            , value_(v) {
+        }
+
+        void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
+            os << value_;
+        }
+
+        [[nodiscard]] const T& GetValue() const {
+            return value_;
+        }
+
+    private:
+        T value_;
+
+        static constexpr ObjectType TypeOf() {
+            if constexpr (std::is_same_v<T, std::int64_t>) {
+                return ObjectType::Number;
+            }
+            else if constexpr (std::is_same_v<T, std::string>) {
+                return ObjectType::String;
+            }
+            else if constexpr (std::is_same_v<T, bool>) {
+                return ObjectType::Bool;
+            }
+            else {
+                return ObjectType::Other;
+            }
+        }
+    };
+
+    // Строковое значение
+    using String = ValueObject<std::string>;
+    // Числовое значение
+    using Number = ValueObject<std::int64_t>;
+
+    // Логическое значение
+    class Bool : public ValueObject<bool> {
+    public:
+        using ValueObject<bool>::ValueObject;
+
+        void Print(std::ostream& os, Context& context) override;
     };
 
+    class Class;
+    class ClassInstance;
+
+    // Возвращает тип, которым обладают все объекты класса T, либо Other, если T - не встроенный
+    // тип Mython и его объекты можно распознать только через dynamic_cast
+    template <typename T>
+    constexpr ObjectType StaticTypeOf() {
+        if constexpr (std::is_same_v<T, Number>) {
+            return ObjectType::Number;
+        }
+        else if constexpr (std::is_same_v<T, String>) {
+            return ObjectType::String;
+        }
+        else if constexpr (std::is_same_v<T, Bool> || std::is_same_v<T, ValueObject<bool>>) {
+            return ObjectType::Bool;
+        }
+        else if constexpr (std::is_same_v<T, Class>) {
+            return ObjectType::Class;
+        }
+        else if constexpr (std::is_same_v<T, ClassInstance>) {
+            return ObjectType::ClassInstance;
+        }
+        else {
+            return ObjectType::Other;
+        }
+    }
 
 
 
-    // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
+    // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе.
+    // Числа и логические значения хранятся непосредственно внутри ObjectHolder и при копировании
+    // копируются, а не разделяются - они неизменяемы, поэтому различие не наблюдаемо.
+    // Остальные объекты размещаются в куче
     class ObjectHolder {
     public:
         // Создаёт пустое значение
         ObjectHolder() = default;
 
+        ObjectHolder(const ObjectHolder& other);
+        ObjectHolder(ObjectHolder&& other) noexcept;
+        ObjectHolder& operator=(const ObjectHolder& other);
+        ObjectHolder& operator=(ObjectHolder&& other) noexcept;
+        ~ObjectHolder();
+
         // Возвращает ObjectHolder, владеющий объектом типа T
         // Тип T - конкретный класс-наследник Object.
-        // object копируется или перемещается в кучу
+        // Number и Bool копируются или перемещаются внутрь ObjectHolder, остальные объекты - в кучу
         template <typename T>
         [[nodiscard]] static ObjectHolder Own(T&& object) {
-            return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
+            using Type = std::decay_t<T>;
+            ObjectHolder result;
+            if constexpr (IsInline<Type>()) {
+                new (result.storage_) Type(std::forward<T>(object));
+                result.tag_ = TagOf<Type>();
+            }
+            else {
+                Object* heap_object = new Type(std::forward<T>(object));
+                heap_object->ref_count_.Increment();
+                new (result.storage_) Object*(heap_object);
+                result.tag_ = Tag::Heap;
+            }
+            return result;
         }
 
-        // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
+        // Создаёт ObjectHolder, ссылающийся на object. Если объектом уже владеют другие ObjectHolder,
+        // результат становится ещё одним владельцем, иначе - не владеет объектом (аналог слабой ссылки).
+        // Счётчик ссылок не собирает циклы: объект, сохранивший ссылку на себя в своём поле
+        // (self.me = self) или в поле другого объекта, который ссылается на него, не будет удалён
+        // после исчезновения внешних ссылок, пока цикл не разорван присваиванием полю другого значения
         [[nodiscard]] static ObjectHolder Share(Object& object);
         // Создаёт пустой ObjectHolder, соответствующий значению None
         [[nodiscard]] static ObjectHolder None();
@@ -63,52 +303,175 @@ namespace runtime {
 
         Object* operator->() const;
 
-        [[nodiscard]] Object* Get() const;
+        [[nodiscard]] Object* Get() const {
+            switch (tag_) {
+            case Tag::Heap:
+            case Tag::Borrowed:
+                return StoredPointer();
+            case Tag::Number:
+                return InlineObject<Number>();
+            case Tag::Bool:
+                return InlineObject<Bool>();
+            default:
+                return nullptr;
+            }
+        }
+
+        // Возвращает тип хранимого объекта, для пустого ObjectHolder - ObjectType::None
+        [[nodiscard]] ObjectType GetType() const {
+            switch (tag_) {
+            case Tag::Heap:
+            case Tag::Borrowed:
+                return StoredPointer()->GetType();
+            case Tag::Number:
+                return ObjectType::Number;
+            case Tag::Bool:
+                return ObjectType::Bool;
+            default:
+                return ObjectType::None;
+            }
+        }
 
         // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
-        // объект данного типа
+        // объект данного типа.
+        // Встроенные типы распознаются по типу объекта, остальные - через dynamic_cast.
+        // Указатель на число или логическое значение действителен, пока существует этот ObjectHolder
         template <typename T>
         [[nodiscard]] T* TryAs() const {
-            return dynamic_cast<T*>(this->Get());
+            constexpr ObjectType type = StaticTypeOf<T>();
+            if constexpr (type != ObjectType::Other) {
+                if (GetType() != type) {
+                    return nullptr;
+                }
+                if constexpr (IsInline<T>()) {
+                    if (tag_ == TagOf<T>()) {
+                        return InlineObject<T>();
+                    }
+                }
+                return static_cast<T*>(this->Get());
+            }
+            else {
+                return dynamic_cast<T*>(this->Get());
+            }
         }
 
         // Возвращает true, если ObjectHolder не пуст
-        explicit operator bool() const;
+        explicit operator bool() const {
+            return tag_ != Tag::Empty;
+        }
 
     private:
-        explicit ObjectHolder(std::shared_ptr<Object> data);
-        void AssertIsValid() const;
+        // Способ хранения объекта
+        enum class Tag : std::uint8_t {
+            Empty,     // None
+            Heap,      // в storage_ лежит указатель на объект в куче, которым владеет ObjectHolder
+            Borrowed,  // в storage_ лежит невладеющий указатель Object*
+            Number,    // в storage_ лежит Number
+            Bool,      // в storage_ лежит Bool
+        };
 
-        std::shared_ptr<Object> data_;
+        template <typename T>
+        static constexpr bool IsInline() {
+            return std::is_same_v<T, Number> || std::is_same_v<T, Bool>;
+        }
+
+        template <typename T>
+        static constexpr Tag TagOf() {
+            return std::is_same_v<T, Number> ? Tag::Number : Tag::Bool;
+        }
+
+        static constexpr size_t STORAGE_SIZE = std::max({ sizeof(Object*), sizeof(Number), sizeof(Bool) });
+        static constexpr size_t STORAGE_ALIGN = std::max({ alignof(Object*), alignof(Number), alignof(Bool) });
+
+        Object* StoredPointer() const {
+            return *std::launder(reinterpret_cast<Object**>(storage_));
+        }
+
+        template <typename T>
+        T* InlineObject() const {
+            return std::launder(reinterpret_cast<T*>(storage_));
+        }
+
+        void CopyFrom(const ObjectHolder& other);
+        void MoveFrom(ObjectHolder& other) noexcept;
+        void Reset() noexcept;
+
+        // Содержимое изменяется только через неконстантные методы, но указатели на хранимый
+        // объект выдаются и константным ObjectHolder
+        alignas(STORAGE_ALIGN) mutable unsigned char storage_[STORAGE_SIZE];
+        Tag tag_ = Tag::Empty;
     };
 
 
 
 
-    // Объект-значение, хранящий значение типа T
-    template <typename T>
-    class ValueObject : public Object {
+
+
+
+    // Кадр вызова метода. Локальные переменные, параметры и self разрешаются парсером в номера
+    // слотов, поэтому доступ к ним - обращение к массиву по индексу без хеширования имён
+    class Frame {
     public:
-        ValueObject(T v)  
-            : value_(v) {
-        }
+        explicit Frame(size_t size);
 
-        void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
-            os << value_;
-        }
+        // Возвращает указатель на значение слота или nullptr, если слоту ещё ничего не присвоено
+        [[nodiscard]] ObjectHolder* Find(size_t slot);
 
-        [[nodiscard]] const T& GetValue() const {
-            return value_;
-        }
+        // Связывает слот со значением и возвращает ссылку на него
+        ObjectHolder& Assign(size_t slot, ObjectHolder value);
+
+        [[nodiscard]] size_t Size() const;
 
     private:
-        T value_;
+        struct Slot {
+            ObjectHolder value;
+            bool bound = false;
+        };
+
+        std::vector<Slot> slots_;
     };
 
+    // Таблица символов, связывающая имя объекта с его значением.
+    // При вызове метода, тело которого разрешено в слоты, переменные хранятся в кадре вызова,
+    // а сама таблица остаётся пустой - именованное представление используется для программы
+    // верхнего уровня и при встраивании интерпретатора
+    class Closure : public std::unordered_map<Symbol, ObjectHolder> {
+    public:
+        using unordered_map::unordered_map;
+
+        // Создаёт таблицу, переменные которой хранятся в кадре frame
+        explicit Closure(Frame& frame)
+            : frame_(&frame) {
+        }
 
+        // Возвращает кадр вызова или nullptr, если переменные хранятся по именам
+        [[nodiscard]] Frame* GetFrame() const {
+            return frame_;
+        }
 
-    // Таблица символов, связывающая имя объекта с его значением
-    using Closure = std::unordered_map<std::string, ObjectHolder>;
+        // Отмечает, что выполнена инструкция return со значением value.
+        // Составные инструкции прекращают выполнение, пока отметка не будет снята
+        void SetReturnValue(ObjectHolder value) {
+            return_value_ = std::move(value);
+            returning_ = true;
+        }
+
+        // Возвращает true, если выполнение тела метода прервано инструкцией return
+        [[nodiscard]] bool IsReturning() const {
+            return returning_;
+        }
+
+        // Снимает отметку о выполнении return и возвращает переданное в неё значение
+        ObjectHolder TakeReturnValue() {
+            returning_ = false;
+            return std::move(return_value_);
+        }
+
+    private:
+        Frame* frame_ = nullptr;
+        ObjectHolder return_value_;
+        bool returning_ = false;
+    };
 
     // Проверяет, содержится ли в object значение, приводимое к True
     // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
@@ -125,27 +488,80 @@ namespace runtime {
         virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
     };
 
-    // Строковое значение
-    using String = ValueObject<std::string>;
-    // Числовое значение
-    using Number = ValueObject<int>;
 
-    // Логическое значение
-    class Bool : public ValueObject<bool> {
-    public:
-        using ValueObject<bool>::ValueObject;
+    struct Method;
 
-        void Print(std::ostream& os, Context& context) override;
+    // Исходное описание тела метода, разбор которого отложен до первого вызова
+    class MethodSource {
+    public:
+        virtual ~MethodSource() = default;
+        // Разбирает тело метода method, заполняя method.body и method.frame_size
+        virtual void Parse(const Method& method) const = 0;
     };
 
     // Метод класса
     struct Method {
+        // Разбирает тело метода, если его разбор был отложен. Если при разборе возникла ошибка,
+        // она выбрасывается при каждом вызове
+        void Load() const {
+            if (source) {
+                source->Parse(*this);
+                source.reset();
+            }
+        }
+
         // Имя метода
-        std::string name;
+        Symbol name;
         // Имена формальных параметров метода
-        std::vector<std::string> formal_params;
-        // Тело метода
-        std::unique_ptr<Executable> body;
+        std::vector<Symbol> formal_params;
+        // Тело метода. Если разбор тела отложен, тело появляется после вызова Load
+        mutable std::unique_ptr<Executable> body;
+        // Размер кадра вызова, если переменные тела разрешены в слоты: слот 0 - self,
+        // слоты 1..formal_params.size() - параметры. 0 - тело обращается к переменным по именам
+        mutable size_t frame_size = 0;
+        // Номер имени метода. Если номер не задан, он назначается при создании класса
+        MethodId id = NO_METHOD_ID;
+        // Источник тела, разбор которого отложен, либо nullptr, если тело уже разобрано
+        mutable std::unique_ptr<MethodSource> source = nullptr;
+    };
+
+    // Форма (скрытый класс) объекта - упорядоченный набор имён его полей. Поле с номером i
+    // хранится в i-й ячейке объекта. Формы образуют дерево переходов: объекты одного класса,
+    // получающие поля в одном и том же порядке, разделяют одну и ту же форму
+    class Shape {
+    public:
+        static constexpr size_t NO_FIELD = static_cast<size_t>(-1);
+        // Объект с большим количеством полей переводится в словарный режим
+        static constexpr size_t MAX_FIELDS = 64;
+
+        Shape() = default;
+
+        // Возвращает номер ячейки поля name или NO_FIELD, если такого поля нет
+        [[nodiscard]] size_t Find(Symbol name) const;
+
+        // Возвращает форму, получающуюся добавлением поля name, или nullptr,
+        // если количество полей превысит MAX_FIELDS
+        [[nodiscard]] const Shape* AddField(Symbol name) const;
+
+        // Имена полей в порядке номеров ячеек
+        [[nodiscard]] const std::vector<Symbol>& GetFieldNames() const {
+            return names_;
+        }
+
+    private:
+        std::vector<Symbol> names_;
+        std::unordered_map<Symbol, size_t> offsets_;
+        // Дерево переходов достраивается по мере появления новых наборов полей
+        mutable std::unordered_map<Symbol, std::unique_ptr<Shape>> transitions_;
+    };
+
+    // Кэш доступа к полю, хранящийся в точке обращения к нему.
+    // Запоминает форму объекта и номер ячейки поля; transition отличен от nullptr,
+    // если запись поля добавляет его к объекту формы shape и переводит объект в форму transition
+    struct FieldCache {
+        const Shape* shape = nullptr;
+        const Shape* transition = nullptr;
+        size_t offset = 0;
     };
 
 
@@ -156,22 +572,56 @@ namespace runtime {
     public:
         // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
         // Если parent равен nullptr, то создаётся базовый класс
-        explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
+        explicit Class(Symbol name, std::vector<Method> methods, const Class* parent);
 
         // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
-        [[nodiscard]] const Method* GetMethod(const std::string& name) const;
+        // как у самого класса, так и у всех его предков
+        [[nodiscard]] const Method* GetMethod(Symbol name) const;
+        // То же, но метод задан номером имени
+        [[nodiscard]] const Method* GetMethod(MethodId id) const;
+        // Возвращает специальный метод класса или его предков либо nullptr, если метода нет
+        [[nodiscard]] const Method* GetMethod(SpecialMethod method) const {
+            return special_methods_[static_cast<size_t>(method)];
+        }
 
         // Возвращает имя класса
         [[nodiscard]] const std::string& GetName() const;
 
+        // Возвращает родительский класс или nullptr
+        [[nodiscard]] const Class* GetParent() const {
+            return parent_;
+        }
+
+        // Возвращает методы, объявленные в самом классе
+        [[nodiscard]] const std::vector<Method>& GetMethods() const {
+            return methods_;
+        }
+
         // Выводит в os строку "Class <имя класса>", например "Class cat"
         void Print(std::ostream& os, Context& context) override;
 
+        // Возвращает форму только что созданного экземпляра класса
+        [[nodiscard]] const Shape& GetRootShape() const {
+            return root_shape_;
+        }
+
     private:
+        friend class ClassInstance;
+
+        // Возвращает метод, объявленный в самом классе, или nullptr
+        [[nodiscard]] const Method* FindOwnMethod(MethodId id) const;
+
         const Class* parent_;
-        std::string name_;
+        Symbol name_;
         std::vector<Method> methods_;
-        std::unordered_map<std::string_view, const Method*> vt_methods_;
+        // Собственные методы класса, упорядоченные по номерам имён. Методы предков ищутся
+        // в их таблицах, поэтому размер таблицы не зависит от количества имён методов в программе
+        std::vector<const Method*> method_table_;
+        std::array<const Method*, SPECIAL_METHOD_COUNT> special_methods_{};
+        Shape root_shape_;
+        // Наибольшее количество полей, встречавшееся у экземпляров класса.
+        // Новые экземпляры сразу резервируют под поля столько ячеек
+        mutable size_t instance_size_ = 0;
     };
 
 
@@ -193,45 +643,75 @@ namespace runtime {
          * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
          * runtime_error
          */
-        ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,
+        ObjectHolder Call(Symbol method, const std::vector<ObjectHolder>& actual_args,
+            Context& context);
+        ObjectHolder Call(SpecialMethod method, const std::vector<ObjectHolder>& actual_args,
+            Context& context);
+
+        // Вызывает у объекта уже найденный метод method. Количество actual_args должно совпадать
+        // с количеством формальных параметров метода
+        ObjectHolder Call(const Method& method, const std::vector<ObjectHolder>& actual_args,
             Context& context);
 
         // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
-        [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
+        [[nodiscard]] bool HasMethod(Symbol method, size_t argument_count) const;
+        [[nodiscard]] bool HasMethod(SpecialMethod method, size_t argument_count) const;
 
-        // Возвращает ссылку на Closure, содержащий поля объекта
+        // Возвращает ссылку на Closure, содержащий поля объекта.
+        // Произвольные изменения полей через Closure не согласуются с формой, поэтому
+        // объект необратимо переводится в словарный режим
         [[nodiscard]] Closure& Fields();
         // Возвращает константную ссылку на Closure, содержащую поля объекта
         [[nodiscard]] const Closure& Fields() const;
 
+        // Возвращает указатель на значение поля name или nullptr, если поля нет
+        [[nodiscard]] ObjectHolder* FindField(Symbol name);
+        // То же, но использует и обновляет кэш точки обращения к полю
+        [[nodiscard]] ObjectHolder* FindField(Symbol name, FieldCache& cache);
+
+        // Присваивает полю name значение value, добавляя поле при необходимости
+        ObjectHolder& SetField(Symbol name, ObjectHolder value);
+        ObjectHolder& SetField(Symbol name, ObjectHolder value, FieldCache& cache);
+
+        // Возвращает форму объекта или nullptr, если объект находится в словарном режиме
+        [[nodiscard]] const Shape* GetShape() const {
+            return shape_;
+        }
+
+        // Возвращает класс, экземпляром которого является объект
+        [[nodiscard]] const Class& GetClass() const;
+
     private:
-        Closure closure_;
         const Class& class_;
+        // Поля хранятся в ячейках fields_ согласно форме shape_. В словарном режиме
+        // shape_ равен nullptr, а поля хранятся в dictionary_.
+        // Переход в словарный режим не меняет наблюдаемого состояния объекта, поэтому
+        // допускается и из константного Fields()
+        mutable const Shape* shape_;
+        mutable std::vector<ObjectHolder> fields_;
+        mutable std::unique_ptr<Closure> dictionary_;
+
+        Closure& ToDictionary() const;
     };
 
 
+    // Сравнивает предикатом cmp значения lhs и rhs, если они - числа, строки или значения Bool
+    // одного типа, иначе возвращает nullopt. Тип значений определяется по их типу объекта
     template <typename Predicate>
     std::optional<bool> Comparator(const ObjectHolder& lhs, const ObjectHolder& rhs, Predicate cmp) {
-
-        Bool* lhs_is_bool = lhs.TryAs<Bool>();
-        Bool* rhs_is_bool = rhs.TryAs<Bool>();
-        if (lhs_is_bool && rhs_is_bool) {
-            return cmp(lhs_is_bool->GetValue(), rhs_is_bool->GetValue());
-        }
-
-        Number* lhs_is_num = lhs.TryAs<Number>();
-        Number* rhs_is_num = rhs.TryAs<Number>();
-        if (lhs_is_num && rhs_is_num) {
-            return cmp(lhs_is_num->GetValue(), rhs_is_num->GetValue());
+        if (lhs.GetType() != rhs.GetType()) {
+            return std::nullopt;
         }
-
-        String* lhs_is_string = lhs.TryAs<String>();
-        String* rhs_is_string = rhs.TryAs<String>();
-        if (lhs_is_string && rhs_is_string) {
-            return cmp(lhs_is_string->GetValue(), rhs_is_string->GetValue());
+        switch (lhs.GetType()) {
+        case ObjectType::Bool:
+            return cmp(lhs.TryAs<Bool>()->GetValue(), rhs.TryAs<Bool>()->GetValue());
+        case ObjectType::Number:
+            return cmp(lhs.TryAs<Number>()->GetValue(), rhs.TryAs<Number>()->GetValue());
+        case ObjectType::String:
+            return cmp(lhs.TryAs<String>()->GetValue(), rhs.TryAs<String>()->GetValue());
+        default:
+            return std::nullopt;
         }
-
-        return std::nullopt;
     }
 
 
@@ -263,6 +743,22 @@ namespace runtime {
     // Возвращает значение, противоположное Less(lhs, rhs, context)
     bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
 
+    /*
+     * Возвращает сумму чисел либо конкатенацию строк lhs и rhs.
+     * Если lhs - объект с методом __add__, возвращает результат вызова lhs.__add__(rhs).
+     * В остальных случаях функция выбрасывает исключение runtime_error.
+     *
+     * Параметр context задаёт контекст для выполнения метода __add__
+     */
+    ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+
+    // Арифметические операции над числами Mython, общие для обоих движков исполнения.
+    // Результат, не представимый 64-битным числом, и деление на 0 выбрасывают исключение runtime_error
+    std::int64_t AddNumbers(std::int64_t lhs, std::int64_t rhs);
+    std::int64_t SubtractNumbers(std::int64_t lhs, std::int64_t rhs);
+    std::int64_t MultiplyNumbers(std::int64_t lhs, std::int64_t rhs);
+    std::int64_t DivideNumbers(std::int64_t lhs, std::int64_t rhs);
+
     // Контекст-заглушка, применяется в тестах.
     // В этом контексте весь вывод перенаправляется в строковый поток вывода output
     struct DummyContext : Context {
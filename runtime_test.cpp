@@ -19,7 +19,8 @@ public:
     }
 
     Logger(const Logger& rhs)
-        : id_(rhs.id_)  //
+        : Object(rhs)
+        , id_(rhs.id_)  //
     {
         ++instance_count;
     }
@@ -218,6 +219,62 @@ void TestOwning() {
     ASSERT_EQUAL(context.output.str(), "312"sv);
 }
 
+void TestSharedOwnership() {
+    ASSERT_EQUAL(Logger::instance_count, 0);
+    {
+        auto one = ObjectHolder::Own(Logger(5));
+        {
+            ObjectHolder two = one;
+            ObjectHolder three;
+            three = two;
+            ASSERT(two.Get() == one.Get() && three.Get() == one.Get());
+            ASSERT_EQUAL(Logger::instance_count, 1);
+
+            one = ObjectHolder::None();
+            ASSERT_EQUAL(Logger::instance_count, 1);
+            two = ObjectHolder::Own(Logger(6));
+            ASSERT_EQUAL(Logger::instance_count, 2);
+        }
+        ASSERT_EQUAL(Logger::instance_count, 0);
+
+        // Присваивание объекта самому себе не уничтожает его
+        one = ObjectHolder::Own(Logger(7));
+        ObjectHolder& alias = one;
+        one = alias;
+        ASSERT_EQUAL(Logger::instance_count, 1);
+        ASSERT_EQUAL(static_cast<Logger*>(one.Get())->GetId(), 7);
+
+        // Ссылка на объект, которым владеет ObjectHolder, тоже владеет им
+        ObjectHolder shared = ObjectHolder::Share(*one);
+        one = ObjectHolder::None();
+        ASSERT_EQUAL(Logger::instance_count, 1);
+        ASSERT_EQUAL(static_cast<Logger*>(shared.Get())->GetId(), 7);
+    }
+    ASSERT_EQUAL(Logger::instance_count, 0);
+}
+
+void TestOwnershipCycle() {
+    ASSERT_EQUAL(Logger::instance_count, 0);
+    Class cls{"Node"s, {}, nullptr};
+    {
+        ObjectHolder node = ObjectHolder::Own(ClassInstance{cls});
+        auto* instance = node.TryAs<ClassInstance>();
+        instance->SetField("log"s, ObjectHolder::Own(Logger(1)));
+        instance->SetField("me"s, ObjectHolder::Share(*instance));
+        node = ObjectHolder::None();
+
+        // Объект ссылается сам на себя, поэтому переживает последнюю внешнюю ссылку
+        ASSERT_EQUAL(Logger::instance_count, 1);
+
+        // Разрывать цикл нужно, удерживая объект: иначе он удалится во время присваивания полю
+        ObjectHolder keep = *instance->FindField("me"s);
+        instance->SetField("me"s, ObjectHolder::None());
+        ASSERT_EQUAL(Logger::instance_count, 1);
+        keep = ObjectHolder::None();
+    }
+    ASSERT_EQUAL(Logger::instance_count, 0);
+}
+
 void TestMove() {
     {
         ASSERT_EQUAL(Logger::instance_count, 0);
@@ -242,6 +299,37 @@ void TestMove() {
     }
 }
 
+void TestInlineValues() {
+    // Числа и логические значения хранятся внутри ObjectHolder
+    ObjectHolder num = ObjectHolder::Own(Number{42});
+    ObjectHolder flag = ObjectHolder::Own(Bool{true});
+    ASSERT(num && flag);
+    ASSERT(num.TryAs<Number>() != nullptr && num.TryAs<Number>()->GetValue() == 42);
+    ASSERT(num.TryAs<Bool>() == nullptr && num.TryAs<String>() == nullptr);
+    ASSERT(flag.TryAs<Bool>() != nullptr && flag.TryAs<Bool>()->GetValue());
+    ASSERT(flag.TryAs<ValueObject<bool>>() != nullptr);
+    ASSERT(flag.TryAs<Number>() == nullptr);
+
+    ObjectHolder copy = num;
+    ASSERT_EQUAL(copy.TryAs<Number>()->GetValue(), 42);
+    ObjectHolder moved = std::move(copy);
+    ASSERT(!copy);  // NOLINT
+    ASSERT_EQUAL(moved.TryAs<Number>()->GetValue(), 42);
+
+    moved = flag;
+    ASSERT(moved.TryAs<Number>() == nullptr);
+    ASSERT(moved.TryAs<Bool>()->GetValue());
+    moved = ObjectHolder::Own(String{"str"s});
+    ASSERT_EQUAL(moved.TryAs<String>()->GetValue(), "str"s);
+    moved = ObjectHolder::None();
+    ASSERT(!moved);
+
+    // Невладеющая ссылка на число указывает на исходный объект
+    Number external{7};
+    ObjectHolder shared = ObjectHolder::Share(external);
+    ASSERT(shared.TryAs<Number>() == &external);
+}
+
 void TestNullptr() {
     ObjectHolder oh;
     ASSERT(!oh);
@@ -282,6 +370,38 @@ void TestIsTrue() {
     }
 }
 
+void TestObjectTypes() {
+    Class cls{"Test"s, {}, nullptr};
+    ASSERT(ObjectHolder::None().GetType() == ObjectType::None);
+    ASSERT(ObjectHolder::Own(Number{1}).GetType() == ObjectType::Number);
+    ASSERT(ObjectHolder::Own(Bool{true}).GetType() == ObjectType::Bool);
+    ASSERT(ObjectHolder::Own(String{"s"s}).GetType() == ObjectType::String);
+    ASSERT(ObjectHolder::Share(cls).GetType() == ObjectType::Class);
+    ASSERT(ObjectHolder::Own(ClassInstance{cls}).GetType() == ObjectType::ClassInstance);
+    ASSERT(ObjectHolder::Own(Logger{}).GetType() == ObjectType::Other);
+
+    // Невладеющая ссылка на число распознаётся по типу объекта
+    Number external{5};
+    ObjectHolder shared = ObjectHolder::Share(external);
+    ASSERT(shared.TryAs<Number>() == &external);
+    ASSERT(shared.TryAs<String>() == nullptr);
+    ASSERT(shared.TryAs<ClassInstance>() == nullptr);
+    ASSERT(ObjectHolder::Share(cls).TryAs<Class>() == &cls);
+
+    // Объекты прочих типов распознаются через dynamic_cast
+    ObjectHolder logger = ObjectHolder::Own(Logger{3});
+    ASSERT_EQUAL(logger.TryAs<Logger>()->GetId(), 3);
+    ASSERT(logger.TryAs<Number>() == nullptr);
+
+    DummyContext ctx;
+    ASSERT_EQUAL(Add(ObjectHolder::Own(Number{2}), shared, ctx).TryAs<Number>()->GetValue(), 7);
+    ASSERT_EQUAL(Add(ObjectHolder::Own(String{"a"s}), ObjectHolder::Own(String{"b"s}), ctx)
+        .TryAs<String>()->GetValue(), "ab"s);
+    ASSERT_THROWS(Add(ObjectHolder::Own(Number{2}), ObjectHolder::Own(String{"b"s}), ctx), runtime_error);
+    ASSERT_THROWS(Add(ObjectHolder::None(), ObjectHolder::None(), ctx), runtime_error);
+    ASSERT_THROWS(Equal(logger, logger, ctx), runtime_error);
+}
+
 void TestComparison() {
     auto test_equal = [](const ObjectHolder& lhs, const ObjectHolder& rhs, bool equality_result) {
         DummyContext ctx;
@@ -472,6 +592,40 @@ void TestComparison() {
         lt_result = ObjectHolder::Own(Bool{true});
         test_greater(ObjectHolder::Share(lhs), ObjectHolder::Share(rhs), false);
     }
+    {
+        // Comparator сравнивает только встроенные значения одного типа
+        const auto num = ObjectHolder::Own(Number{1});
+        const auto str = ObjectHolder::Own(String{"a"s});
+        ASSERT(Comparator(num, ObjectHolder::Own(Number{2}), std::less<>()) == std::optional<bool>(true));
+        ASSERT(Comparator(str, ObjectHolder::Own(String{"a"s}), std::equal_to<>()) == std::optional<bool>(true));
+        ASSERT(Comparator(ObjectHolder::Own(Bool{true}), ObjectHolder::Own(Bool{false}), std::less<>())
+               == std::optional<bool>(false));
+        ASSERT(!Comparator(num, str, std::less<>()).has_value());
+        ASSERT(!Comparator(ObjectHolder::None(), ObjectHolder::None(), std::equal_to<>()).has_value());
+    }
+}
+
+void TestSymbols() {
+    const Symbol x("x"sv);
+    const string name = "x"s;
+    // Одинаковые имена - один и тот же символ с общей строкой имени
+    ASSERT(x == Symbol(name));
+    ASSERT(&x.Name() == &Symbol("x").Name());
+    ASSERT(x != Symbol("y"sv));
+    ASSERT_EQUAL(x.Hash(), hash<string_view>{}("x"sv));
+    ASSERT_EQUAL(Symbol().Name(), ""s);
+
+    // Номер имени метода назначается один раз
+    const Symbol method("symbol_test_method"sv);
+    ASSERT_EQUAL(method.GetMethodId(), NO_METHOD_ID);
+    const MethodId id = InternMethodName(method);
+    ASSERT_EQUAL(InternMethodName("symbol_test_method"s), id);
+    ASSERT_EQUAL(FindMethodId(method), id);
+
+    Closure closure;
+    closure[x] = ObjectHolder::Own(Number{1});
+    ASSERT_EQUAL(closure.count("x"s), 1U);
+    ASSERT_EQUAL(closure.count("y"s), 0U);
 }
 
 void TestClass() {
@@ -504,6 +658,55 @@ void TestClass() {
     ASSERT_EQUAL(out.str(), "Class Test"s);
 }
 
+void TestClassHierarchy() {
+    auto make_method = [](const string& name, int result) {
+        auto body = [result](Closure& /*closure*/, Context& /*ctx*/) {
+            return ObjectHolder::Own(Number{result});
+        };
+        return Method{name, {}, make_unique<TestMethodBody>(body)};
+    };
+
+    vector<Method> base_methods;
+    base_methods.push_back(make_method("base"s, 1));
+    base_methods.push_back(make_method("overridden"s, 1));
+    base_methods.push_back(make_method(STR_METHOD, 10));
+    Class base{"Base"s, move(base_methods), nullptr};
+
+    vector<Method> middle_methods;
+    middle_methods.push_back(make_method("overridden"s, 2));
+    Class middle{"Middle"s, move(middle_methods), &base};
+
+    vector<Method> derived_methods;
+    derived_methods.push_back(make_method("derived"s, 3));
+    derived_methods.push_back(make_method("twice"s, 4));
+    derived_methods.push_back(make_method("twice"s, 5));
+    Class derived{"Derived"s, move(derived_methods), &middle};
+
+    // Методы ищутся по всей цепочке предков, а не только у непосредственного родителя
+    ASSERT(derived.GetMethod("base"s) == base.GetMethod("base"s));
+    ASSERT(derived.GetMethod("overridden"s) == middle.GetMethod("overridden"s));
+    ASSERT(derived.GetMethod("overridden"s) != base.GetMethod("overridden"s));
+    ASSERT(base.GetMethod("derived"s) == nullptr);
+    ASSERT(derived.GetMethod(FindMethodId("derived"s)) == derived.GetMethod("derived"s));
+    ASSERT(derived.GetMethod(NO_METHOD_ID) == nullptr);
+
+    DummyContext ctx;
+    ClassInstance instance{derived};
+    ASSERT_EQUAL(instance.Call("base"s, {}, ctx).TryAs<Number>()->GetValue(), 1);
+    ASSERT_EQUAL(instance.Call("overridden"s, {}, ctx).TryAs<Number>()->GetValue(), 2);
+    ASSERT_EQUAL(instance.Call("derived"s, {}, ctx).TryAs<Number>()->GetValue(), 3);
+    // Из одноимённых методов класса действует объявленный последним
+    ASSERT_EQUAL(instance.Call("twice"s, {}, ctx).TryAs<Number>()->GetValue(), 5);
+
+    // Специальные методы предков попадают в таблицу специальных методов потомка
+    ASSERT(derived.GetMethod(SpecialMethod::Str) == base.GetMethod(STR_METHOD));
+    ASSERT(derived.GetMethod(SpecialMethod::Eq) == nullptr);
+    ASSERT(instance.HasMethod(SpecialMethod::Str, 0U));
+    ASSERT(!instance.HasMethod(SpecialMethod::Str, 1U));
+    instance.Print(ctx.output, ctx);
+    ASSERT_EQUAL(ctx.output.str(), "10"s);
+}
+
 void TestClassInstance() {
     vector<Method> methods;
 
@@ -529,6 +732,59 @@ void TestClassInstance() {
     ASSERT_THROWS(instance.Call("missing_method"s, {}, ctx), runtime_error);
 }
 
+void TestClassInstanceShapes() {
+    Class cls{"Point"s, {}, nullptr};
+
+    // Экземпляры, получающие поля в одном порядке, разделяют форму
+    ClassInstance a{cls};
+    ClassInstance b{cls};
+    ASSERT_EQUAL(a.GetShape(), &cls.GetRootShape());
+    a.SetField("x"s, ObjectHolder::Own(Number{1}));
+    a.SetField("y"s, ObjectHolder::Own(Number{2}));
+    FieldCache cache;
+    b.SetField("x"s, ObjectHolder::Own(Number{3}), cache);
+    b.SetField("y"s, ObjectHolder::Own(Number{4}));
+    ASSERT(a.GetShape() != nullptr);
+    ASSERT_EQUAL(a.GetShape(), b.GetShape());
+    ASSERT_EQUAL(a.GetShape()->Find("y"s), 1U);
+    ASSERT_EQUAL(a.GetShape()->Find("z"s), Shape::NO_FIELD);
+
+    // Другой порядок полей даёт другую форму
+    ClassInstance c{cls};
+    c.SetField("y"s, ObjectHolder::Own(Number{5}));
+    c.SetField("x"s, ObjectHolder::Own(Number{6}));
+    ASSERT(c.GetShape() != a.GetShape());
+
+    // Кэш перехода добавляет поле новому объекту без поиска по имени
+    ClassInstance d{cls};
+    d.SetField("x"s, ObjectHolder::Own(Number{7}), cache);
+    ASSERT_EQUAL(d.GetShape(), cls.GetRootShape().AddField("x"s));
+
+    FieldCache read_cache;
+    ASSERT_EQUAL(a.FindField("y"s, read_cache)->TryAs<Number>()->GetValue(), 2);
+    ASSERT_EQUAL(b.FindField("y"s, read_cache)->TryAs<Number>()->GetValue(), 4);
+    ASSERT(d.FindField("y"s, read_cache) == nullptr);
+
+    // Обращение к Fields() переводит объект в словарный режим, сохраняя значения полей
+    Closure& fields = a.Fields();
+    ASSERT(a.GetShape() == nullptr);
+    ASSERT_EQUAL(fields.size(), 2U);
+    ASSERT_EQUAL(fields.at("x"s).TryAs<Number>()->GetValue(), 1);
+    fields["z"s] = ObjectHolder::Own(Number{8});
+    ASSERT_EQUAL(a.FindField("z"s, read_cache)->TryAs<Number>()->GetValue(), 8);
+    a.SetField("x"s, ObjectHolder::Own(Number{9}), cache);
+    ASSERT_EQUAL(fields.at("x"s).TryAs<Number>()->GetValue(), 9);
+
+    // Объект со слишком большим количеством полей также переходит в словарный режим
+    ClassInstance e{cls};
+    for (size_t i = 0; i <= Shape::MAX_FIELDS; ++i) {
+        e.SetField("f"s + to_string(i), ObjectHolder::Own(Number{static_cast<int>(i)}));
+    }
+    ASSERT(e.GetShape() == nullptr);
+    ASSERT_EQUAL(e.Fields().size(), Shape::MAX_FIELDS + 1);
+    ASSERT_EQUAL(e.FindField("f0"s)->TryAs<Number>()->GetValue(), 0);
+}
+
 }  // namespace
 
 void RunObjectsTests(TestRunner& tr) {
@@ -537,16 +793,23 @@ void RunObjectsTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestBool);
     RUN_TEST(tr, runtime::TestMethodInvocation);
     RUN_TEST(tr, runtime::TestIsTrue);
+    RUN_TEST(tr, runtime::TestObjectTypes);
     RUN_TEST(tr, runtime::TestComparison);
+    RUN_TEST(tr, runtime::TestSymbols);
     RUN_TEST(tr, runtime::TestClass);
+    RUN_TEST(tr, runtime::TestClassHierarchy);
     RUN_TEST(tr, runtime::TestClassInstance);
+    RUN_TEST(tr, runtime::TestClassInstanceShapes);
 }
 
 void RunObjectHolderTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestNonowning);
     RUN_TEST(tr, runtime::TestOwning);
+    RUN_TEST(tr, runtime::TestSharedOwnership);
+    RUN_TEST(tr, runtime::TestOwnershipCycle);
     RUN_TEST(tr, runtime::TestMove);
     RUN_TEST(tr, runtime::TestNullptr);
+    RUN_TEST(tr, runtime::TestInlineValues);
 }
 
 }  // namespace runtime
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include "scan.h"
+
+#include <atomic>
+
+// Векторные реализации собираются для x86. GCC и Clang позволяют собрать AVX2-функции
+// отдельно от остального кода и выбрать их во время работы, если процессор их поддерживает
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define MYTHON_SCAN_SSE2
+#define MYTHON_SCAN_AVX2
+#define MYTHON_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_M_X64)
+#define MYTHON_SCAN_SSE2
+#include <intrin.h>
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace parse {
+namespace scan {
+
+	namespace {
+
+		bool IsIdChar(char c) {
+			return (c >= 'a' && c <= 'z')
+				|| (c >= 'A' && c <= 'Z')
+				|| (c >= '0' && c <= '9')
+				|| c == '_';
+		}
+
+		bool IsStringStop(char c, char quote) {
+			return c == quote || c == '\\' || c == '\n' || c == '\r';
+		}
+
+		// Скалярные реализации. Ими же векторные реализации дочитывают хвост короче одного блока
+
+		const char* SkipSpacesScalar(const char* begin, const char* end) {
+			while (begin != end && *begin == ' ') {
+				++begin;
+			}
+			return begin;
+		}
+
+		const char* FindLineEndScalar(const char* begin, const char* end) {
+			while (begin != end && *begin != '\n') {
+				++begin;
+			}
+			return begin;
+		}
+
+		const char* SkipIdCharsScalar(const char* begin, const char* end) {
+			while (begin != end && IsIdChar(*begin)) {
+				++begin;
+			}
+			return begin;
+		}
+
+		const char* FindStringStopScalar(const char* begin, const char* end, char quote) {
+			while (begin != end && !IsStringStop(*begin, quote)) {
+				++begin;
+			}
+			return begin;
+		}
+
+#ifdef MYTHON_SCAN_SSE2
+		// Номер младшего установленного бита. mask не равна нулю
+		unsigned LowestBit(unsigned mask) {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return static_cast<unsigned>(index);
+#else
+			return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+		}
+
+		// Для каждого байта block - признак «буква, цифра или '_'».
+		// Сравнения знаковые, поэтому байты не из ASCII в диапазоны не попадают
+		__m128i IdCharMask(__m128i block) {
+			const __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+			const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+				_mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+			const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)),
+				_mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+			const __m128i underscore = _mm_cmpeq_epi8(block, _mm_set1_epi8('_'));
+			return _mm_or_si128(_mm_or_si128(alpha, digit), underscore);
+		}
+
+		const char* SkipSpacesSse2(const char* begin, const char* end) {
+			const __m128i space = _mm_set1_epi8(' ');
+			for (; end - begin >= 16; begin += 16) {
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+				const unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, space))) & 0xFFFFu;
+				if (stop != 0) {
+					return begin + LowestBit(stop);
+				}
+			}
+			return SkipSpacesScalar(begin, end);
+		}
+
+		const char* FindLineEndSse2(const char* begin, const char* end) {
+			const __m128i newline = _mm_set1_epi8('\n');
+			for (; end - begin >= 16; begin += 16) {
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+				const unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+				if (stop != 0) {
+					return begin + LowestBit(stop);
+				}
+			}
+			return FindLineEndScalar(begin, end);
+		}
+
+		const char* SkipIdCharsSse2(const char* begin, const char* end) {
+			for (; end - begin >= 16; begin += 16) {
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+				const unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(IdCharMask(block))) & 0xFFFFu;
+				if (stop != 0) {
+					return begin + LowestBit(stop);
+				}
+			}
+			return SkipIdCharsScalar(begin, end);
+		}
+
+		const char* FindStringStopSse2(const char* begin, const char* end, char quote) {
+			const __m128i quotes = _mm_set1_epi8(quote);
+			const __m128i backslash = _mm_set1_epi8('\\');
+			const __m128i newline = _mm_set1_epi8('\n');
+			const __m128i carriage_return = _mm_set1_epi8('\r');
+			for (; end - begin >= 16; begin += 16) {
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+				const __m128i hits = _mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(block, quotes), _mm_cmpeq_epi8(block, backslash)),
+					_mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, carriage_return)));
+				const unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(hits));
+				if (stop != 0) {
+					return begin + LowestBit(stop);
+				}
+			}
+			return FindStringStopScalar(begin, end, quote);
+		}
+#endif  // MYTHON_SCAN_SSE2
+
+#ifdef MYTHON_SCAN_AVX2
+		// Те же алгоритмы, что и для SSE2, но блоками по 32 байта
+
+		MYTHON_AVX2_TARGET __m256i IdCharMask256(__m256i block) {
+			const __m256i lower = _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+			const __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+				_mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+			const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)),
+				_mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), block));
+			const __m256i underscore = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('_'));
+			return _mm256_or_si256(_mm256_or_si256(alpha, digit), underscore);
+		}
+
+		MYTHON_AVX2_TARGET const char* SkipSpacesAvx2(const char* begin, const char* end) {
+			const __m256i space = _mm256_set1_epi8(' ');
+			for (; end - begin >= 32; begin += 32) {
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+				const unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, space)));
+				if (stop != 0) {
+					return begin + LowestBit(stop);
+				}
+			}
+			return SkipSpacesSse2(begin, end);
+		}
+
+		MYTHON_AVX2_TARGET const char* FindLineEndAvx2(const char* begin, const char* end) {
+			const __m256i newline = _mm256_set1_epi8('\n');
+			for (; end - begin >= 32; begin += 32) {
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+				const unsigned stop = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline)));
+				if (stop != 0) {
+					return begin + LowestBit(stop);
+				}
+			}
+			return FindLineEndSse2(begin, end);
+		}
+
+		MYTHON_AVX2_TARGET const char* SkipIdCharsAvx2(const char* begin, const char* end) {
+			for (; end - begin >= 32; begin += 32) {
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+				const unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(IdCharMask256(block)));
+				if (stop != 0) {
+					return begin + LowestBit(stop);
+				}
+			}
+			return SkipIdCharsSse2(begin, end);
+		}
+
+		MYTHON_AVX2_TARGET const char* FindStringStopAvx2(const char* begin, const char* end, char quote) {
+			const __m256i quotes = _mm256_set1_epi8(quote);
+			const __m256i backslash = _mm256_set1_epi8('\\');
+			const __m256i newline = _mm256_set1_epi8('\n');
+			const __m256i carriage_return = _mm256_set1_epi8('\r');
+			for (; end - begin >= 32; begin += 32) {
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+				const __m256i hits = _mm256_or_si256(
+					_mm256_or_si256(_mm256_cmpeq_epi8(block, quotes), _mm256_cmpeq_epi8(block, backslash)),
+					_mm256_or_si256(_mm256_cmpeq_epi8(block, newline), _mm256_cmpeq_epi8(block, carriage_return)));
+				const unsigned stop = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+				if (stop != 0) {
+					return begin + LowestBit(stop);
+				}
+			}
+			return FindStringStopSse2(begin, end, quote);
+		}
+#endif  // MYTHON_SCAN_AVX2
+
+		constexpr Kernels SCALAR_KERNELS{
+			Kernel::Scalar, SkipSpacesScalar, FindLineEndScalar, SkipIdCharsScalar, FindStringStopScalar
+		};
+#ifdef MYTHON_SCAN_SSE2
+		constexpr Kernels SSE2_KERNELS{
+			Kernel::Sse2, SkipSpacesSse2, FindLineEndSse2, SkipIdCharsSse2, FindStringStopSse2
+		};
+#endif
+#ifdef MYTHON_SCAN_AVX2
+		constexpr Kernels AVX2_KERNELS{
+			Kernel::Avx2, SkipSpacesAvx2, FindLineEndAvx2, SkipIdCharsAvx2, FindStringStopAvx2
+		};
+#endif
+
+		const Kernels& KernelsOf(Kernel kernel) {
+			switch (kernel) {
+#ifdef MYTHON_SCAN_AVX2
+			case Kernel::Avx2:
+				return AVX2_KERNELS;
+#endif
+#ifdef MYTHON_SCAN_SSE2
+			case Kernel::Sse2:
+				return SSE2_KERNELS;
+#endif
+			default:
+				return SCALAR_KERNELS;
+			}
+		}
+
+		atomic<const Kernels*>& ActiveKernels() {
+			static atomic<const Kernels*> active{ &GetKernels(Kernel::Avx2) };
+			return active;
+		}
+
+	}  // namespace
+
+	const Kernels& GetKernels() {
+		return *ActiveKernels().load(memory_order_relaxed);
+	}
+
+	const Kernels& GetKernels(Kernel kernel) {
+		while (kernel != Kernel::Scalar && !IsSupported(kernel)) {
+			kernel = static_cast<Kernel>(static_cast<int>(kernel) - 1);
+		}
+		return KernelsOf(kernel);
+	}
+
+	bool IsSupported(Kernel kernel) {
+		switch (kernel) {
+		case Kernel::Scalar:
+			return true;
+		case Kernel::Sse2:
+#ifdef MYTHON_SCAN_SSE2
+			return true;
+#else
+			return false;
+#endif
+		case Kernel::Avx2:
+#ifdef MYTHON_SCAN_AVX2
+			return __builtin_cpu_supports("avx2") != 0;
+#else
+			return false;
+#endif
+		}
+		return false;
+	}
+
+	void SetKernel(Kernel kernel) {
+		ActiveKernels().store(&GetKernels(kernel), memory_order_relaxed);
+	}
+
+	std::string_view GetKernelName(Kernel kernel) {
+		switch (kernel) {
+		case Kernel::Scalar:
+			return "scalar"sv;
+		case Kernel::Sse2:
+			return "sse2"sv;
+		case Kernel::Avx2:
+			return "avx2"sv;
+		}
+		return "unknown"sv;
+	}
+
+}  // namespace scan
+}  // namespace parse
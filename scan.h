@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string_view>
+
+namespace parse {
+namespace scan {
+
+    // Реализация функций поиска. Векторные реализации просматривают текст блоками
+    // по 16 (SSE2) или 32 (AVX2) байта
+    enum class Kernel {
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+
+    // Функции поиска «интересного» символа в диапазоне [begin, end).
+    // Каждая возвращает указатель на найденный символ либо end, если символ не найден
+    struct Kernels {
+        Kernel kernel;
+        // Первый символ, отличный от пробела
+        const char* (*skip_spaces)(const char* begin, const char* end);
+        // Первый символ '\n'
+        const char* (*find_line_end)(const char* begin, const char* end);
+        // Первый символ, который не может входить в идентификатор: не буква, цифра или '_'
+        const char* (*skip_id_chars)(const char* begin, const char* end);
+        // Первая кавычка quote, '\\', '\n' или '\r'
+        const char* (*find_string_stop)(const char* begin, const char* end, char quote);
+    };
+
+    // Возвращает выбранную реализацию. По умолчанию выбирается лучшая из поддерживаемых процессором
+    [[nodiscard]] const Kernels& GetKernels();
+
+    // Возвращает реализацию kernel, а если она не поддерживается - лучшую из поддерживаемых
+    // более простых реализаций
+    [[nodiscard]] const Kernels& GetKernels(Kernel kernel);
+
+    // Возвращает true, если реализация kernel собрана и поддерживается процессором
+    [[nodiscard]] bool IsSupported(Kernel kernel);
+
+    // Выбирает реализацию GetKernels(kernel) для лексеров, создаваемых после вызова
+    void SetKernel(Kernel kernel);
+
+    [[nodiscard]] std::string_view GetKernelName(Kernel kernel);
+
+}  // namespace scan
+}  // namespace parse
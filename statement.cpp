@@ -10,62 +10,90 @@ namespace ast {
 	using runtime::ObjectHolder;
 
 	namespace {
-		const string ADD_METHOD = "__add__"s;
-		const string INIT_METHOD = "__init__"s;
 		const string NONE_OBJECT = "None"s;
+
+		// Суммарные счётчики кэшей всех точек вызова методов
+		MethodCall::CacheStats total_cache_stats;
 	}  // namespace
 
 	ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
 		ObjectHolder newVar = rv_->Execute(closure, context);
+		if (runtime::Frame* frame = closure.GetFrame(); frame && slot_ != VariableValue::NO_SLOT) {
+			return frame->Assign(slot_, move(newVar));
+		}
 		return closure[var_name_] = newVar;
 	}
 
-	Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv)
-		: var_name_(move(var))
+	Assignment::Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv)
+		: var_name_(var)
+		, rv_(move(rv))
+	{
+	}
+
+	Assignment::Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv, size_t slot)
+		: var_name_(var)
 		, rv_(move(rv))
+		, slot_(slot)
 	{
 	}
 
-	VariableValue::VariableValue(const std::string& var_name)
-		: var_name_({ var_name })
+	VariableValue::VariableValue(runtime::Symbol var_name)
+		: var_name_(var_name)
 	{
 	}
 
-	VariableValue::VariableValue(std::vector<std::string> dotted_ids)
+	VariableValue::VariableValue(std::vector<runtime::Symbol> dotted_ids)
 	{
 		// Забираем первое значение из очереди в оборот
 		if (dotted_ids.size() > 0) {
-			var_name_ = move(dotted_ids[0]);
-			for (size_t i = 1; i < dotted_ids.size(); ++i) {
-				dotted_ids_.push_back(move(dotted_ids[i]));
-			}
+			var_name_ = dotted_ids[0];
+			dotted_ids_.assign(dotted_ids.begin() + 1, dotted_ids.end());
 		}
+		field_caches_.resize(dotted_ids_.size());
 	}
 
-	ObjectHolder VariableValue::Execute(Closure& closure, Context& context) {
-		auto it = closure.find(var_name_);
-		if (it != closure.end()) {
-			ObjectHolder& result = it->second;
+	VariableValue::VariableValue(const std::vector<std::string>& dotted_ids)
+		: VariableValue(std::vector<runtime::Symbol>(dotted_ids.begin(), dotted_ids.end()))
+	{
+	}
 
-			if (dotted_ids_.size() > 0) {
-				// рекурсивно вычисляем значения всех переменных
-				runtime::ClassInstance* obj = result.TryAs<runtime::ClassInstance>();
-				if (obj) {
-					return VariableValue(dotted_ids_).Execute(obj->Fields(), context);
-				}
-				else {
-					throw std::runtime_error("Variable " + var_name_ + " is not class"s);
-				}
-			}
+	VariableValue::VariableValue(std::vector<runtime::Symbol> dotted_ids, size_t slot)
+		: VariableValue(move(dotted_ids))
+	{
+		slot_ = slot;
+	}
 
-			return result;
+	ObjectHolder VariableValue::Execute(Closure& closure, [[maybe_unused]] Context& context) {
+		const ObjectHolder* result = nullptr;
+		if (runtime::Frame* frame = closure.GetFrame(); frame && slot_ != NO_SLOT) {
+			result = frame->Find(slot_);
 		}
-		else {
-			throw std::runtime_error("Variable "s + var_name_ + " not found"s);
+		else if (auto it = closure.find(var_name_); it != closure.end()) {
+			result = &it->second;
+		}
+		if (result == nullptr) {
+			throw std::runtime_error("Variable "s + var_name_.Name() + " not found"s);
+		}
+
+		// Последовательно спускаемся по цепочке полей id1.id2.id3
+		runtime::Symbol name = var_name_;
+		for (size_t i = 0; i < dotted_ids_.size(); ++i) {
+			const runtime::Symbol field = dotted_ids_[i];
+			runtime::ClassInstance* obj = result->TryAs<runtime::ClassInstance>();
+			if (obj == nullptr) {
+				throw std::runtime_error("Variable "s + name.Name() + " is not class"s);
+			}
+			result = obj->FindField(field, field_caches_[i]);
+			if (result == nullptr) {
+				throw std::runtime_error("Variable "s + field.Name() + " not found"s);
+			}
+			name = field;
 		}
+
+		return *result;
 	}
 
-	unique_ptr<Print> Print::Variable(const std::string& name) {
+	unique_ptr<Print> Print::Variable(runtime::Symbol name) {
 		return make_unique<Print>(make_unique<VariableValue>(name));
 	}
 
@@ -100,32 +128,84 @@ namespace ast {
 		return {};
 	}
 
-	MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
+	MethodCall::MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method,
 		std::vector<std::unique_ptr<Statement>> args)
 		: object_(move(object))
-		, method_(move(method))
+		, method_(method)
+		, method_id_(runtime::InternMethodName(method_))
 		, args_(move(args))
 	{
 	}
 
 	ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
-		runtime::ClassInstance* clsInst = object_->Execute(closure, context).TryAs<runtime::ClassInstance>();
+		ObjectHolder object = object_->Execute(closure, context);
+		runtime::ClassInstance* clsInst = object.TryAs<runtime::ClassInstance>();
 
 		if (clsInst) {
-			if (clsInst->HasMethod(method_, args_.size())) {
+			const runtime::Method* method = ResolveMethod(clsInst->GetClass());
+			if (method != nullptr) {
 				std::vector<runtime::ObjectHolder> actual_args;
+				actual_args.reserve(args_.size());
 				for (auto& arg : args_) {
 					actual_args.emplace_back(arg->Execute(closure, context));
 				}
 
-				return clsInst->Call(method_, actual_args, context);
+				return clsInst->Call(*method, actual_args, context);
 			}
-			throw runtime_error("Class has no method "s + method_);
+			throw runtime_error("Class has no method "s + method_.Name());
 		}
 
 		throw runtime_error("Object is not class instance"s);
 	}
 
+	const runtime::Method* MethodCall::ResolveMethod(const runtime::Class& cls) {
+		CacheStats& total = total_cache_stats;
+
+		for (size_t i = 0; i < cache_size_; ++i) {
+			if (cache_[i].cls == &cls) {
+				++stats_.hits;
+				++total.hits;
+				return cache_[i].method;
+			}
+		}
+
+		++stats_.misses;
+		++total.misses;
+
+		const runtime::Method* method = cls.GetMethod(method_id_);
+		if (method == nullptr || method->formal_params.size() != args_.size()) {
+			return nullptr;
+		}
+
+		if (cache_size_ < cache_.size()) {
+			cache_[cache_size_++] = { &cls, method };
+		}
+		else {
+			megamorphic_ = true;
+			++stats_.megamorphic_misses;
+			++total.megamorphic_misses;
+		}
+		return method;
+	}
+
+	MethodCall::CacheState MethodCall::GetCacheState() const {
+		if (megamorphic_) {
+			return CacheState::Megamorphic;
+		}
+		if (cache_size_ == 0) {
+			return CacheState::Empty;
+		}
+		return cache_size_ == 1 ? CacheState::Monomorphic : CacheState::Polymorphic;
+	}
+
+	const MethodCall::CacheStats& MethodCall::GetTotalCacheStats() {
+		return total_cache_stats;
+	}
+
+	void MethodCall::ResetTotalCacheStats() {
+		total_cache_stats = {};
+	}
+
 	ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
 		ObjectHolder obj = arg_->Execute(closure, context);
 		if (obj) {
@@ -138,66 +218,50 @@ namespace ast {
 	}
 
 	ObjectHolder Add::Execute(Closure& closure, Context& context) {
-		ObjectHolder lhs = lhs_->Execute(closure, context);
-		ObjectHolder rhs = rhs_->Execute(closure, context);
-
-		//  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
-		runtime::ClassInstance* lhs_is_class = lhs.TryAs<runtime::ClassInstance>();
-		if (lhs_is_class) {
-			return lhs_is_class->Call(ADD_METHOD, { rhs }, context);
-		}
+		return Add::Apply(ExecuteLhs(closure, context), closure, context);
+	}
 
-		{
-			auto l = lhs.TryAs<runtime::Number>(); auto r = rhs.TryAs<runtime::Number>();
-			if (l && r) {
-				return ObjectHolder::Own<runtime::Number>(l->GetValue() + r->GetValue());
-			}
-		}
-		{
-			auto l = lhs.TryAs<runtime::String>(); auto r = rhs.TryAs<runtime::String>();
-			if (l && r) {
-				return ObjectHolder::Own<runtime::String>(l->GetValue() + r->GetValue());
-			}
-		}
+	ObjectHolder Add::Apply(const ObjectHolder& lhs, Closure& closure, Context& context) {
+		ObjectHolder rhs = rhs_->Execute(closure, context);
 
-		throw std::runtime_error("Cannot execute binary operation"s);
+		return runtime::Add(lhs, rhs, context);
 	}
 
 	ObjectHolder Sub::Execute(Closure& closure, Context& context) {
+		return Sub::Apply(ExecuteLhs(closure, context), closure, context);
+	}
+
+	ObjectHolder Sub::Apply(const ObjectHolder& lhs, Closure& closure, Context& context) {
 
 		return ObjectHolder::Own<runtime::Number>(
-			NumberBynaryOperation(
-				lhs_, rhs_, closure, context,
-				[](const int a, const int b) {
-					return a - b;
-				}
-		));
+			NumberBynaryOperation(lhs, rhs_, closure, context, runtime::SubtractNumbers));
 	}
 
 	ObjectHolder Mult::Execute(Closure& closure, Context& context) {
+		return Mult::Apply(ExecuteLhs(closure, context), closure, context);
+	}
+
+	ObjectHolder Mult::Apply(const ObjectHolder& lhs, Closure& closure, Context& context) {
 		return ObjectHolder::Own<runtime::Number>(
-			NumberBynaryOperation(
-				lhs_, rhs_, closure, context,
-				[](const int a, const int b) {
-					return a * b;
-				}
-		));
+			NumberBynaryOperation(lhs, rhs_, closure, context, runtime::MultiplyNumbers));
 	}
 
 	ObjectHolder Div::Execute(Closure& closure, Context& context) {
+		return Div::Apply(ExecuteLhs(closure, context), closure, context);
+	}
+
+	ObjectHolder Div::Apply(const ObjectHolder& lhs, Closure& closure, Context& context) {
 
 		return ObjectHolder::Own<runtime::Number>(
-			NumberBynaryOperation(
-				lhs_, rhs_, closure, context,
-				[](const int a, const int b) {
-					return a / b;
-				}
-		));
+			NumberBynaryOperation(lhs, rhs_, closure, context, runtime::DivideNumbers));
 	}
 
 	ObjectHolder Compound::Execute(Closure& closure, Context& context) {
 		for (auto& arg : args_) {
 			arg->Execute(closure, context);
+			if (closure.IsReturning()) {
+				break;
+			}
 		}
 		return ObjectHolder::None();
 	}
@@ -208,7 +272,9 @@ namespace ast {
 	}
 
 	ObjectHolder Return::Execute(Closure& closure, Context& context) {
-		throw stmt_->Execute(closure, context);
+		ObjectHolder result = stmt_->Execute(closure, context);
+		closure.SetReturnValue(result);
+		return result;
 	}
 
 	ClassDefinition::ClassDefinition(ObjectHolder cls)
@@ -221,18 +287,20 @@ namespace ast {
 		return ObjectHolder::None();
 	}
 
-	FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
+	FieldAssignment::FieldAssignment(VariableValue object, runtime::Symbol field_name,
 		std::unique_ptr<Statement> rv)
 		: object_(move(object))
-		, field_name_(move(field_name))
+		, field_name_(field_name)
 		, rv_(move(rv))
 	{
 	}
 
 	ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
-		runtime::ClassInstance* obj = object_.Execute(closure, context).TryAs<runtime::ClassInstance>();
+		// Держим объект, пока вычисляется присваиваемое значение
+		ObjectHolder object = object_.Execute(closure, context);
+		runtime::ClassInstance* obj = object.TryAs<runtime::ClassInstance>();
 		if (obj) {
-			return obj->Fields()[field_name_] = rv_->Execute(closure, context);
+			return obj->SetField(field_name_, rv_->Execute(closure, context), field_cache_);
 		}
 		else {
 			throw runtime_error("Object is not class"s);
@@ -249,7 +317,7 @@ namespace ast {
 
 	ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
 		ObjectHolder if_cnd = condition_->Execute(closure, context);
-		if (if_cnd.TryAs<runtime::Bool>()->GetValue()) {
+		if (runtime::IsTrue(if_cnd)) {
 			if_body_->Execute(closure, context);
 		}
 		else if (else_body_ != nullptr) {
@@ -260,7 +328,10 @@ namespace ast {
 	}
 
 	ObjectHolder Or::Execute(Closure& closure, Context& context) {
-		runtime::ObjectHolder lhs = lhs_->Execute(closure, context);
+		return Or::Apply(ExecuteLhs(closure, context), closure, context);
+	}
+
+	ObjectHolder Or::Apply(const ObjectHolder& lhs, Closure& closure, Context& context) {
 		runtime::Bool* l = lhs.TryAs<runtime::Bool>();
 
 		if (l) {
@@ -279,7 +350,10 @@ namespace ast {
 	}
 
 	ObjectHolder And::Execute(Closure& closure, Context& context) {
-		runtime::ObjectHolder lhs = lhs_->Execute(closure, context);
+		return And::Apply(ExecuteLhs(closure, context), closure, context);
+	}
+
+	ObjectHolder And::Apply(const ObjectHolder& lhs, Closure& closure, Context& context) {
 		runtime::Bool* l = lhs.TryAs<runtime::Bool>();
 
 		if (l) {
@@ -314,31 +388,39 @@ namespace ast {
 	}
 
 	ObjectHolder Comparison::Execute(Closure& closure, Context& context) {
-		bool res = cmp_(lhs_->Execute(closure, context), rhs_->Execute(closure, context), context);
+		return Comparison::Apply(ExecuteLhs(closure, context), closure, context);
+	}
+
+	ObjectHolder Comparison::Apply(const ObjectHolder& lhs, Closure& closure, Context& context) {
+		bool res = cmp_(lhs, rhs_->Execute(closure, context), context);
 		return  ObjectHolder::Own<runtime::Bool>(res);
 	}
 
 	NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args)
-		: class__({ class_ })
+		: class_(class_)
 		, args_(move(args))
 	{
 	}
 
 	NewInstance::NewInstance(const runtime::Class& class_)
-		: class__({ class_ })
+		: class_(class_)
 	{
 	}
 
 	ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
-		if (class__.HasMethod(INIT_METHOD, args_.size())) {
+		// Каждое вычисление выражения создаёт новый объект
+		ObjectHolder result = ObjectHolder::Own(runtime::ClassInstance(class_));
+		runtime::ClassInstance* obj = result.TryAs<runtime::ClassInstance>();
+
+		if (obj->HasMethod(runtime::SpecialMethod::Init, args_.size())) {
 			vector<runtime::ObjectHolder> args;
 			for (auto& arg : args_) {
 				args.push_back(arg->Execute(closure, context));
 			}
-			class__.Call(INIT_METHOD, args, context);
+			obj->Call(runtime::SpecialMethod::Init, args, context);
 		}
 
-		return ObjectHolder::Share(class__);
+		return result;
 	}
 
 	MethodBody::MethodBody(std::unique_ptr<Statement>&& body)
@@ -347,16 +429,11 @@ namespace ast {
 	}
 
 	ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
-		try {
-			body_->Execute(closure, context);
-			return runtime::ObjectHolder::None();
-		}
-		catch (runtime::ObjectHolder& result) {
-			return result;
-		}
-		catch (...) {
-			throw;
+		body_->Execute(closure, context);
+		if (closure.IsReturning()) {
+			return closure.TakeReturnValue();
 		}
+		return runtime::ObjectHolder::None();
 	}
 
 	UnaryOperation::UnaryOperation(std::unique_ptr<Statement> argument)
@@ -367,7 +444,37 @@ namespace ast {
 	BinaryOperation::BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs)
 		: lhs_(move(lhs))
 		, rhs_(move(rhs))
+		, lhs_operation_(dynamic_cast<BinaryOperation*>(lhs_.get()))
 	{
+		if (lhs_operation_) {
+			lhs_operation_->parent_ = this;
+		}
+	}
+
+	BinaryOperation::~BinaryOperation() {
+		// Узлы левой ветви отцепляются по одному, и каждый удаляется уже без своего левого аргумента
+		while (BinaryOperation* child = lhs_operation_) {
+			lhs_operation_ = child->lhs_operation_;
+			child->lhs_operation_ = nullptr;
+			unique_ptr<Statement> owned = move(lhs_);
+			lhs_ = move(child->lhs_);
+		}
+	}
+
+	ObjectHolder BinaryOperation::ExecuteLeftChain(Closure& closure, Context& context) {
+		BinaryOperation* node = lhs_operation_;
+		while (node->lhs_operation_) {
+			node = node->lhs_operation_;
+		}
+
+		ObjectHolder result = node->lhs_->Execute(closure, context);
+		while (true) {
+			result = node->Apply(result, closure, context);
+			if (node == lhs_operation_) {
+				return result;
+			}
+			node = node->parent_;
+		}
 	}
 
 
@@ -2,6 +2,7 @@
 
 #include "runtime.h"
 
+#include <array>
 #include <iostream>
 #include <sstream>
 #include <functional>
@@ -16,16 +17,22 @@ template <typename T>
 class ValueStatement : public Statement {
 public:
     explicit ValueStatement(T v)
-        : value_(std::move(v)) {
+        : value_(runtime::ObjectHolder::Own(std::move(v))) {
     }
 
+    // Значение возвращается во владение, а не по ссылке: переменная, которой присвоена константа,
+    // может пережить инструкцию, например при потоковом исполнении программы
     runtime::ObjectHolder Execute([[maybe_unused]] runtime::Closure& closure,
         [[maybe_unused]] runtime::Context& context) override {
-        return runtime::ObjectHolder::Share(value_);
+        return value_;
+    }
+
+    [[nodiscard]] const T& GetValue() const {
+        return *value_.TryAs<T>();
     }
 
 private:
-    T value_;
+    runtime::ObjectHolder value_;
 };
 
 using NumericConst = ValueStatement<runtime::Number>;
@@ -39,39 +46,88 @@ x = circle.center.x
 */
 class VariableValue : public Statement {
 public:
-    explicit VariableValue(const std::string& var_name);
-    explicit VariableValue(std::vector<std::string> dotted_ids);
+    // Переменная не разрешена в слот кадра и ищется в closure по имени
+    static constexpr size_t NO_SLOT = static_cast<size_t>(-1);
+
+    explicit VariableValue(runtime::Symbol var_name);
+    explicit VariableValue(std::vector<runtime::Symbol> dotted_ids);
+    explicit VariableValue(const std::vector<std::string>& dotted_ids);
+    // Первый идентификатор цепочки - локальная переменная, хранящаяся в слоте slot кадра вызова
+    VariableValue(std::vector<runtime::Symbol> dotted_ids, size_t slot);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] runtime::Symbol GetName() const {
+        return var_name_;
+    }
+
+    [[nodiscard]] const std::vector<runtime::Symbol>& GetDottedIds() const {
+        return dotted_ids_;
+    }
+
+    [[nodiscard]] size_t GetSlot() const {
+        return slot_;
+    }
+
 private:
-    std::string var_name_;
-    std::vector<std::string> dotted_ids_;
+    runtime::Symbol var_name_;
+    std::vector<runtime::Symbol> dotted_ids_;
+    size_t slot_ = NO_SLOT;
+    // Кэши доступа к полям цепочки, по одному на каждый элемент dotted_ids_
+    std::vector<runtime::FieldCache> field_caches_;
 };
 
 // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
 class Assignment : public Statement {
 public:
-    Assignment(std::string var, std::unique_ptr<Statement> rv);
+    Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv);
+    // Переменная var хранится в слоте slot кадра вызова
+    Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv, size_t slot);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] runtime::Symbol GetVarName() const {
+        return var_name_;
+    }
+
+    [[nodiscard]] const Statement& GetRValue() const {
+        return *rv_;
+    }
+
+    [[nodiscard]] size_t GetSlot() const {
+        return slot_;
+    }
+
 private:
-    std::string var_name_;
+    runtime::Symbol var_name_;
     std::unique_ptr<Statement> rv_;
+    size_t slot_ = VariableValue::NO_SLOT;
 };
 
 // Присваивает полю object.field_name значение выражения rv
 class FieldAssignment : public Statement {
 public:
-    FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
+    FieldAssignment(VariableValue object, runtime::Symbol field_name, std::unique_ptr<Statement> rv);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const VariableValue& GetObject() const {
+        return object_;
+    }
+
+    [[nodiscard]] runtime::Symbol GetFieldName() const {
+        return field_name_;
+    }
+
+    [[nodiscard]] const Statement& GetRValue() const {
+        return *rv_;
+    }
+
 private:
     VariableValue object_;
-    std::string field_name_;
+    runtime::Symbol field_name_;
     std::unique_ptr<Statement> rv_;
+    runtime::FieldCache field_cache_;
 };
 
 // Значение None
@@ -92,28 +148,89 @@ public:
     explicit Print(std::vector<std::unique_ptr<Statement>> args);
 
     // Инициализирует команду print для вывода значения переменной name
-    static std::unique_ptr<Print> Variable(const std::string& name);
+    static std::unique_ptr<Print> Variable(runtime::Symbol name);
 
     // Во время выполнения команды print вывод должен осуществляться в поток, возвращаемый из
     // context.GetOutputStream()
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+        return args_;
+    }
+
 private:
     std::vector<std::unique_ptr<Statement>> args_;
 };
 
-// Вызывает метод object.method со списком параметров args
+// Вызывает метод object.method со списком параметров args.
+// Точка вызова кэширует методы, найденные для классов получателя: первые MAX_CACHE_ENTRIES
+// классов запоминаются, после чего кэш считается мегаморфным и метод ищется по имени
 class MethodCall : public Statement {
 public:
-    MethodCall(std::unique_ptr<Statement> object, std::string method,
+    static constexpr size_t MAX_CACHE_ENTRIES = 4;
+
+    // Состояние кэша точки вызова
+    enum class CacheState {
+        Empty,         // вызовов ещё не было
+        Monomorphic,   // получатель всегда одного класса
+        Polymorphic,   // запомнено от 2 до MAX_CACHE_ENTRIES классов
+        Megamorphic,   // классов больше, чем помещается в кэш
+    };
+
+    // Счётчики обращений к кэшу
+    struct CacheStats {
+        size_t hits = 0;
+        size_t misses = 0;
+        // Промахи, случившиеся после заполнения кэша
+        size_t megamorphic_misses = 0;
+    };
+
+    MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method,
                std::vector<std::unique_ptr<Statement>> args);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const Statement& GetObject() const {
+        return *object_;
+    }
+
+    [[nodiscard]] runtime::Symbol GetMethodName() const {
+        return method_;
+    }
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+        return args_;
+    }
+
+    [[nodiscard]] CacheState GetCacheState() const;
+
+    // Счётчики этой точки вызова
+    [[nodiscard]] const CacheStats& GetCacheStats() const {
+        return stats_;
+    }
+
+    // Суммарные счётчики всех точек вызова
+    [[nodiscard]] static const CacheStats& GetTotalCacheStats();
+    static void ResetTotalCacheStats();
+
 private:
+    struct CacheEntry {
+        const runtime::Class* cls = nullptr;
+        const runtime::Method* method = nullptr;
+    };
+
     std::unique_ptr<Statement> object_;
-    std::string method_;
+    runtime::Symbol method_;
+    runtime::MethodId method_id_;
     std::vector<std::unique_ptr<Statement>> args_;
+
+    std::array<CacheEntry, MAX_CACHE_ENTRIES> cache_;
+    size_t cache_size_ = 0;
+    bool megamorphic_ = false;
+    CacheStats stats_;
+
+    // Возвращает метод, подходящий для вызова у объекта класса cls, либо nullptr
+    const runtime::Method* ResolveMethod(const runtime::Class& cls);
 };
 
 /*
@@ -133,11 +250,19 @@ class NewInstance : public Statement {
 public:
     explicit NewInstance(const runtime::Class& class_);
     NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
-    // Возвращает объект, содержащий значение типа ClassInstance
+    // Возвращает объект, содержащий новое значение типа ClassInstance
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const runtime::Class& GetClass() const {
+        return class_;
+    }
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+        return args_;
+    }
+
 private:
-    runtime::ClassInstance class__;
+    const runtime::Class& class_;
     std::vector<std::unique_ptr<Statement>> args_;
 };
 
@@ -146,6 +271,10 @@ class UnaryOperation : public Statement {
 public:
     explicit UnaryOperation(std::unique_ptr<Statement> argument);
 
+    [[nodiscard]] const Statement& GetArgument() const {
+        return *arg_;
+    }
+
 protected:
     std::unique_ptr<Statement> arg_;
 };
@@ -157,39 +286,61 @@ public:
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 };
 
-// Родительский класс Бинарная операция с аргументами lhs и rhs
+// Родительский класс Бинарная операция с аргументами lhs и rhs.
+// Цепочка операций вида a + b + c + ... образует левую ветвь дерева. Её узлы вычисляются и удаляются
+// циклом по ветви, поэтому стек вызовов не зависит от длины цепочки
 class BinaryOperation : public Statement {
 public:
     BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
+    ~BinaryOperation() override;
+
+    [[nodiscard]] const Statement& GetLhs() const {
+        return *lhs_;
+    }
+
+    [[nodiscard]] const Statement& GetRhs() const {
+        return *rhs_;
+    }
 
 protected:
     std::unique_ptr<Statement> lhs_;
     std::unique_ptr<Statement> rhs_;
+
+    // Применяет операцию к вычисленному значению левого аргумента lhs.
+    // Правый аргумент вычисляется здесь же, если он нужен
+    virtual runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, runtime::Closure& closure,
+                                        runtime::Context& context) = 0;
+
+    // Вычисляет левый аргумент
+    runtime::ObjectHolder ExecuteLhs(runtime::Closure& closure, runtime::Context& context) {
+        return lhs_operation_ ? ExecuteLeftChain(closure, context) : lhs_->Execute(closure, context);
+    }
+
+private:
+    // Левый аргумент, если он тоже бинарная операция, и операция, левым аргументом которой
+    // является этот узел
+    BinaryOperation* lhs_operation_ = nullptr;
+    BinaryOperation* parent_ = nullptr;
+
+    // Вычисляет левую ветвь, начиная с нижнего узла, и применяет к результату операции узлов ветви
+    runtime::ObjectHolder ExecuteLeftChain(runtime::Closure& closure, runtime::Context& context);
 };
 
 // Бинарные оперции с числовыми объектами
 template <typename Fn>
 runtime::Number NumberBynaryOperation(
-    std::unique_ptr<Statement>& lhs,
+    const runtime::ObjectHolder& lhs,
     std::unique_ptr<Statement>& rhs,
     runtime::Closure& closure, 
     runtime::Context& context, 
     Fn op)
 {
-    runtime::ObjectHolder lhs_ = lhs->Execute(closure, context);
     runtime::ObjectHolder rhs_ = rhs->Execute(closure, context);
 
-    runtime::Number* l = lhs_.TryAs<runtime::Number>();
+    const runtime::Number* l = lhs.TryAs<runtime::Number>();
     runtime::Number* r = rhs_.TryAs<runtime::Number>();
     if (l && r) {
-        try
-        {
-            return op(l->GetValue(), r->GetValue());
-        }
-        catch (...)
-        {
-            throw std::runtime_error("Division by 0"s);
-        }
+        return op(l->GetValue(), r->GetValue());
     }
 
     throw std::runtime_error("Cannot execute binary operation"s);
@@ -206,6 +357,10 @@ public:
     //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
     // В противном случае при вычислении выбрасывается runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+protected:
+    runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, runtime::Closure& closure,
+                                runtime::Context& context) override;
 };
 
 // Возвращает результат вычитания аргументов lhs и rhs
@@ -217,6 +372,10 @@ public:
     //  число - число
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+protected:
+    runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, runtime::Closure& closure,
+                                runtime::Context& context) override;
 };
 
 // Возвращает результат умножения аргументов lhs и rhs
@@ -228,6 +387,10 @@ public:
     //  число * число
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+protected:
+    runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, runtime::Closure& closure,
+                                runtime::Context& context) override;
 };
 
 // Возвращает результат деления lhs и rhs
@@ -240,6 +403,10 @@ public:
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     // Если rhs равен 0, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+protected:
+    runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, runtime::Closure& closure,
+                                runtime::Context& context) override;
 };
 
 // Возвращает результат вычисления логической операции or над lhs и rhs
@@ -249,6 +416,10 @@ public:
     // Значение аргумента rhs вычисляется, только если значение lhs
     // после приведения к Bool равно False
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+protected:
+    runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, runtime::Closure& closure,
+                                runtime::Context& context) override;
 };
 
 // Возвращает результат вычисления логической операции and над lhs и rhs
@@ -258,6 +429,10 @@ public:
     // Значение аргумента rhs вычисляется, только если значение lhs
     // после приведения к Bool равно True
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+protected:
+    runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, runtime::Closure& closure,
+                                runtime::Context& context) override;
 };
 
 // Возвращает результат вычисления логической операции not над единственным аргументом операции
@@ -281,9 +456,21 @@ public:
         args_.push_back(std::move(stmt));
     }
 
-    // Последовательно выполняет добавленные инструкции. Возвращает None
+    // Заменяет count инструкций, начиная с инструкции first, инструкциями statements
+    void ReplaceStatements(size_t first, size_t count, std::vector<std::unique_ptr<Statement>> statements) {
+        const auto begin = args_.begin() + static_cast<std::ptrdiff_t>(first);
+        const auto position = args_.erase(begin, begin + static_cast<std::ptrdiff_t>(count));
+        args_.insert(position, std::make_move_iterator(statements.begin()), std::make_move_iterator(statements.end()));
+    }
+
+    // Последовательно выполняет добавленные инструкции, пока одна из них не выполнит return.
+    // Возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetStatements() const {
+        return args_;
+    }
+
 private:
     std::vector<std::unique_ptr<Statement>> args_;
 
@@ -306,6 +493,10 @@ public:
     // В противном случае возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const Statement& GetBody() const {
+        return *body_;
+    }
+
 private:
     std::unique_ptr<Statement> body_;
 };
@@ -317,8 +508,13 @@ public:
 
     // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
     // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
+    // Результат сохраняется в closure, объемлющие составные инструкции прекращают выполнение
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const Statement& GetStatement() const {
+        return *stmt_;
+    }
+
 private:
     std::unique_ptr<Statement> stmt_;
 };
@@ -333,6 +529,10 @@ public:
     // конструктор
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const runtime::ObjectHolder& GetClass() const {
+        return cls_;
+    }
+
 private:
     runtime::ObjectHolder cls_;
 };
@@ -346,6 +546,19 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const Statement& GetCondition() const {
+        return *condition_;
+    }
+
+    [[nodiscard]] const Statement& GetIfBody() const {
+        return *if_body_;
+    }
+
+    // Возвращает nullptr, если ветка else отсутствует
+    [[nodiscard]] const Statement* GetElseBody() const {
+        return else_body_.get();
+    }
+
 private:
     std::unique_ptr<Statement> condition_;
     std::unique_ptr<Statement> if_body_;
@@ -365,6 +578,14 @@ public:
     // приведённый к типу runtime::Bool
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const Comparator& GetComparator() const {
+        return cmp_;
+    }
+
+protected:
+    runtime::ObjectHolder Apply(const runtime::ObjectHolder& lhs, runtime::Closure& closure,
+                                runtime::Context& context) override;
+
 private:
     Comparator cmp_;
 };
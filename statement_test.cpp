@@ -457,6 +457,75 @@ void TestNot() {
     test_not(false);
 }
 
+void TestFrameSlots() {
+    runtime::DummyContext context;
+
+    runtime::Frame frame(2);
+    Closure closure(frame);
+
+    Assignment assign_x("x"s, make_unique<NumericConst>(runtime::Number(57)), 1);
+    assign_x.Execute(closure, context);
+
+    ASSERT(closure.empty());
+    ASSERT(frame.Find(0) == nullptr);
+    ASSERT(frame.Find(1) != nullptr);
+    ASSERT_OBJECT_VALUE_EQUAL(VariableValue(vector<runtime::Symbol>{"x"s}, 1).Execute(closure, context), 57);
+    ASSERT_THROWS(VariableValue(vector<runtime::Symbol>{"y"s}, 0).Execute(closure, context), std::runtime_error);
+
+    // Неразрешённые в слоты переменные по-прежнему ищутся по имени
+    Closure named = {{"x"s, ObjectHolder::Own(runtime::Number(42))}};
+    ASSERT_OBJECT_VALUE_EQUAL(VariableValue(vector<runtime::Symbol>{"x"s}, 1).Execute(named, context), 42);
+}
+
+void TestMethodCallCache() {
+    runtime::DummyContext context;
+
+    // Пять классов с одноимённым методом, возвращающим номер класса
+    vector<unique_ptr<runtime::Class>> classes;
+    for (int i = 0; i <= static_cast<int>(MethodCall::MAX_CACHE_ENTRIES); ++i) {
+        vector<runtime::Method> methods;
+        methods.push_back({"id"s, {}, make_unique<NumericConst>(runtime::Number(i))});
+        classes.push_back(make_unique<runtime::Class>("C"s + to_string(i), std::move(methods), nullptr));
+    }
+
+    MethodCall call(make_unique<VariableValue>("obj"s), "id"s, {});
+    ASSERT(call.GetCacheState() == MethodCall::CacheState::Empty);
+
+    Closure closure;
+    auto call_with = [&](const runtime::Class& cls) {
+        closure["obj"s] = ObjectHolder::Own(runtime::ClassInstance(cls));
+        return call.Execute(closure, context);
+    };
+
+    ASSERT_OBJECT_VALUE_EQUAL(call_with(*classes[0]), 0);
+    ASSERT_OBJECT_VALUE_EQUAL(call_with(*classes[0]), 0);
+    ASSERT(call.GetCacheState() == MethodCall::CacheState::Monomorphic);
+    ASSERT_EQUAL(call.GetCacheStats().hits, 1U);
+    ASSERT_EQUAL(call.GetCacheStats().misses, 1U);
+
+    for (size_t i = 1; i < MethodCall::MAX_CACHE_ENTRIES; ++i) {
+        ASSERT_OBJECT_VALUE_EQUAL(call_with(*classes[i]), i);
+    }
+    ASSERT(call.GetCacheState() == MethodCall::CacheState::Polymorphic);
+
+    ASSERT_OBJECT_VALUE_EQUAL(call_with(*classes.back()), MethodCall::MAX_CACHE_ENTRIES);
+    ASSERT_OBJECT_VALUE_EQUAL(call_with(*classes.back()), MethodCall::MAX_CACHE_ENTRIES);
+    ASSERT(call.GetCacheState() == MethodCall::CacheState::Megamorphic);
+    ASSERT_EQUAL(call.GetCacheStats().megamorphic_misses, 2U);
+
+    // Закэшированные классы по-прежнему обслуживаются кэшем
+    ASSERT_OBJECT_VALUE_EQUAL(call_with(*classes[2]), 2);
+    ASSERT_EQUAL(call.GetCacheStats().hits, 2U);
+    ASSERT_EQUAL(call.GetCacheStats().misses, MethodCall::MAX_CACHE_ENTRIES + 2);
+
+    // Метод с другим числом параметров не подходит для вызова
+    vector<unique_ptr<Statement>> args;
+    args.push_back(make_unique<NumericConst>(runtime::Number(1)));
+    MethodCall wrong_arity(make_unique<VariableValue>("obj"s), "id"s, std::move(args));
+    ASSERT_THROWS(wrong_arity.Execute(closure, context), std::runtime_error);
+    ASSERT(wrong_arity.GetCacheState() == MethodCall::CacheState::Empty);
+}
+
 }  // namespace
 
 void RunUnitTests(TestRunner& tr) {
@@ -480,6 +549,8 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestOr);
     RUN_TEST(tr, ast::TestAnd);
     RUN_TEST(tr, ast::TestNot);
+    RUN_TEST(tr, ast::TestFrameSlots);
+    RUN_TEST(tr, ast::TestMethodCallCache);
 }
 
 }  // namespace ast
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "symbol.h"
+
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+using namespace std;
+
+namespace runtime {
+
+	// Таблица символов. Записи хранятся в deque, поэтому указатели на них и ключи-string_view
+	// не становятся недействительными при добавлении новых имён.
+	// Лексеры могут работать в разных потоках, поэтому таблица защищена мьютексом
+	struct Symbol::Table {
+		mutex lock;
+		deque<Entry> entries;
+		unordered_map<string_view, const Entry*> index;
+		MethodId method_count = 0;
+
+		static Table& Instance() {
+			static Table table;
+			return table;
+		}
+	};
+
+	Symbol::Symbol() {
+		static const Entry* empty = Symbol(string_view{}).entry_;
+		entry_ = empty;
+	}
+
+	Symbol::Symbol(std::string_view name) {
+		Table& table = Table::Instance();
+		lock_guard guard(table.lock);
+		if (auto it = table.index.find(name); it != table.index.end()) {
+			entry_ = it->second;
+			return;
+		}
+		Entry& entry = table.entries.emplace_back();
+		entry.name = name;
+		entry.hash = hash<string_view>{}(name);
+		table.index.emplace(entry.name, &entry);
+		entry_ = &entry;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const Symbol& symbol) {
+		return os << symbol.Name();
+	}
+
+	MethodId InternMethodName(Symbol name) {
+		Symbol::Table& table = Symbol::Table::Instance();
+		lock_guard guard(table.lock);
+		// Номер назначается под мьютексом, поэтому у одного имени не может появиться двух номеров
+		auto& method_id = name.entry_->method_id;
+		if (method_id.load(memory_order_relaxed) == NO_METHOD_ID) {
+			method_id.store(table.method_count++, memory_order_release);
+		}
+		return method_id.load(memory_order_relaxed);
+	}
+
+}  // namespace runtime
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace runtime {
+
+    // Номер имени метода. Имена методов всех классов нумеруются подряд, поэтому класс
+    // находит метод обращением к таблице по индексу, без хеширования имени
+    using MethodId = std::uint32_t;
+    inline constexpr MethodId NO_METHOD_ID = static_cast<MethodId>(-1);
+
+    // Символ - имя (идентификатор), занесённое в общую для процесса таблицу символов.
+    // Лексер превращает в символы все идентификаторы, парсер и среда выполнения хранят и
+    // сравнивают имена как символы: одинаковые имена - один и тот же символ, поэтому
+    // сравнение - это сравнение указателей, а хеш вычисляется один раз при занесении в таблицу.
+    // Символы не удаляются из таблицы, ссылки на их имена действительны до конца работы программы
+    class Symbol {
+    public:
+        // Символ пустого имени
+        Symbol();
+        // Возвращает символ имени name, занося имя в таблицу при первом обращении.
+        // Неявные преобразования позволяют передавать имена строками
+        Symbol(std::string_view name);
+        Symbol(const std::string& name)
+            : Symbol(std::string_view(name)) {
+        }
+        Symbol(const char* name)
+            : Symbol(std::string_view(name)) {
+        }
+
+        [[nodiscard]] const std::string& Name() const {
+            return entry_->name;
+        }
+
+        [[nodiscard]] std::size_t Hash() const {
+            return entry_->hash;
+        }
+
+        // Номер имени метода или NO_METHOD_ID, если символ ещё не использовался как имя метода
+        [[nodiscard]] MethodId GetMethodId() const {
+            return entry_->method_id.load(std::memory_order_acquire);
+        }
+
+        friend bool operator==(const Symbol& lhs, const Symbol& rhs) {
+            return lhs.entry_ == rhs.entry_;
+        }
+
+        friend bool operator!=(const Symbol& lhs, const Symbol& rhs) {
+            return lhs.entry_ != rhs.entry_;
+        }
+
+        // Упорядочивает символы по именам
+        friend bool operator<(const Symbol& lhs, const Symbol& rhs) {
+            return lhs.Name() < rhs.Name();
+        }
+
+    private:
+        friend MethodId InternMethodName(Symbol name);
+
+        struct Entry {
+            std::string name;
+            std::size_t hash = 0;
+            // Назначается InternMethodName, в том числе из других потоков
+            mutable std::atomic<MethodId> method_id = NO_METHOD_ID;
+        };
+        struct Table;
+
+        const Entry* entry_;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const Symbol& symbol);
+
+    // Возвращает номер имени метода name, назначая новый номер при первом обращении
+    MethodId InternMethodName(Symbol name);
+    // Возвращает номер имени метода name либо NO_METHOD_ID, если такое имя ещё не встречалось
+    [[nodiscard]] inline MethodId FindMethodId(Symbol name) {
+        return name.GetMethodId();
+    }
+
+}  // namespace runtime
+
+namespace std {
+
+    template <>
+    struct hash<runtime::Symbol> {
+        size_t operator()(const runtime::Symbol& symbol) const noexcept {
+            return symbol.Hash();
+        }
+    };
+
+}  // namespace std
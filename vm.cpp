@@ -0,0 +1,376 @@
+#include "vm.h"
+
+#include <sstream>
+
+using namespace std;
+
+namespace vm {
+
+    using bytecode::CallSite;
+    using bytecode::Function;
+    using bytecode::Instruction;
+    using bytecode::OpCode;
+    using runtime::ObjectHolder;
+
+    namespace {
+        const string NONE_OBJECT = "None"s;
+
+        // Значение регистра переменной, которой ещё ничего не присвоено
+        class UnboundObject : public runtime::Object {
+        public:
+            void Print([[maybe_unused]] std::ostream& os, [[maybe_unused]] runtime::Context& context) override {
+                throw runtime_error("Unbound variable"s);
+            }
+        };
+
+        UnboundObject unbound_object;
+
+        const ObjectHolder& Unbound() {
+            static const ObjectHolder unbound = ObjectHolder::Share(unbound_object);
+            return unbound;
+        }
+
+        bool IsUnbound(const ObjectHolder& value) {
+            return value.Get() == &unbound_object;
+        }
+
+        const runtime::Bool& ExpectBool(const ObjectHolder& value, const char* error) {
+            const runtime::Bool* result = value.TryAs<runtime::Bool>();
+            if (result == nullptr) {
+                throw runtime_error(error);
+            }
+            return *result;
+        }
+
+        template <typename Fn>
+        ObjectHolder NumberOperation(const ObjectHolder& lhs, const ObjectHolder& rhs, Fn op) {
+            const runtime::Number* l = lhs.TryAs<runtime::Number>();
+            const runtime::Number* r = rhs.TryAs<runtime::Number>();
+            if (l && r) {
+                return ObjectHolder::Own(runtime::Number(op(l->GetValue(), r->GetValue())));
+            }
+            throw runtime_error("Cannot execute binary operation"s);
+        }
+
+        // Освобождает кадр вызова при выходе из функции, в том числе по исключению
+        class FrameGuard {
+        public:
+            FrameGuard(vector<ObjectHolder>& stack, size_t base)
+                : stack_(stack)
+                , base_(base)
+            {
+            }
+
+            ~FrameGuard() {
+                stack_.resize(base_);
+            }
+
+        private:
+            vector<ObjectHolder>& stack_;
+            size_t base_;
+        };
+    }  // namespace
+
+    VirtualMachine::VirtualMachine(const bytecode::Program& program, runtime::Context& context)
+        : program_(program)
+        , context_(context)
+    {
+        stack_.reserve(1024);
+    }
+
+    void VirtualMachine::Run(runtime::Closure& closure) {
+        const Function& main = program_.GetMain();
+
+        stack_.clear();
+        stack_.resize(main.registers);
+        for (size_t i = 0; i < main.locals.size(); ++i) {
+            auto it = closure.find(main.locals[i]);
+            stack_[i] = it != closure.end() ? it->second : Unbound();
+        }
+
+        auto sync = [&closure, &main, this]() {
+            for (size_t i = 0; i < main.locals.size(); ++i) {
+                if (!IsUnbound(stack_[i])) {
+                    closure[main.locals[i]] = stack_[i];
+                }
+            }
+        };
+
+        try {
+            Execute(main, 0);
+        }
+        catch (...) {
+            sync();
+            throw;
+        }
+        sync();
+    }
+
+    ObjectHolder VirtualMachine::CallMethod(const ObjectHolder& self, runtime::Symbol method,
+        const std::vector<ObjectHolder>& args) {
+
+        runtime::ClassInstance* instance = self.TryAs<runtime::ClassInstance>();
+        return CallResolved(self, instance != nullptr ? instance->GetClass().GetMethod(method) : nullptr, args);
+    }
+
+    ObjectHolder VirtualMachine::CallMethod(const ObjectHolder& self, runtime::SpecialMethod method,
+        const std::vector<ObjectHolder>& args) {
+
+        runtime::ClassInstance* instance = self.TryAs<runtime::ClassInstance>();
+        return CallResolved(self, instance != nullptr ? instance->GetClass().GetMethod(method) : nullptr, args);
+    }
+
+    ObjectHolder VirtualMachine::CallResolved(const ObjectHolder& self, const runtime::Method* resolved,
+        const std::vector<ObjectHolder>& args) {
+
+        if (resolved == nullptr || resolved->formal_params.size() != args.size()) {
+            throw runtime_error("Not implemented"s);
+        }
+
+        // self может ссылаться на регистр, который станет недействительным при росте стека
+        const ObjectHolder self_holder = self;
+        CallSite site{ resolved->name, static_cast<bytecode::Operand>(args.size()), resolved->id };
+        site.cls = &self_holder.TryAs<runtime::ClassInstance>()->GetClass();
+        site.resolved = resolved;
+        site.function = program_.GetMethod(*resolved);
+
+        size_t base = stack_.size();
+        FrameGuard guard(stack_, base);
+        stack_.insert(stack_.end(), args.begin(), args.end());
+        return Invoke(self_holder, site, base);
+    }
+
+    void VirtualMachine::Resolve(const ObjectHolder& object, const CallSite& site) {
+        runtime::ClassInstance* instance = object.TryAs<runtime::ClassInstance>();
+        if (instance == nullptr) {
+            throw runtime_error("Object is not class instance"s);
+        }
+
+        const runtime::Class* cls = &instance->GetClass();
+        if (site.cls == cls) {
+            return;
+        }
+
+        const runtime::Method* method = cls->GetMethod(site.method_id);
+        if (method == nullptr || method->formal_params.size() != site.argc) {
+            throw runtime_error("Class has no method "s + site.method.Name());
+        }
+
+        CallSite& cache = const_cast<CallSite&>(site);
+        cache.cls = cls;
+        cache.resolved = method;
+        cache.function = program_.GetMethod(*method);
+    }
+
+    ObjectHolder VirtualMachine::Invoke(const ObjectHolder& self, const CallSite& site, size_t args) {
+        if (site.function == nullptr) {
+            // Тело метода не скомпилировано, исполняем его деревом
+            vector<ObjectHolder> actual_args(stack_.begin() + args, stack_.begin() + args + site.argc);
+            return self.TryAs<runtime::ClassInstance>()->Call(*site.resolved, actual_args, context_);
+        }
+
+        runtime::Context::CallGuard call(context_);
+        const Function& function = *site.function;
+        size_t base = stack_.size();
+        FrameGuard guard(stack_, base);
+
+        stack_.resize(base + function.registers);
+        stack_[base] = self;
+        for (size_t i = 0; i < site.argc; ++i) {
+            stack_[base + 1 + i] = stack_[args + i];
+        }
+        for (size_t i = function.params; i < function.locals.size(); ++i) {
+            stack_[base + i] = Unbound();
+        }
+
+        return Execute(function, base);
+    }
+
+    ObjectHolder VirtualMachine::Execute(const Function& function, size_t base) {
+        const Instruction* code = function.code.data();
+        auto reg = [this, base](bytecode::Operand index) -> ObjectHolder& {
+            return stack_[base + index];
+        };
+
+        for (size_t pc = 0;; ++pc) {
+            const Instruction& in = code[pc];
+            switch (in.op) {
+            case OpCode::LoadConst:
+                reg(in.a) = function.constants[in.b];
+                break;
+            case OpCode::LoadNone:
+                reg(in.a) = ObjectHolder::None();
+                break;
+            case OpCode::Move:
+                reg(in.a) = reg(in.b);
+                break;
+            case OpCode::CheckBound:
+                if (IsUnbound(reg(in.a))) {
+                    throw runtime_error("Variable "s + function.names[in.b].Name() + " not found"s);
+                }
+                break;
+            case OpCode::GetField: {
+                const runtime::Symbol name = function.names[in.c];
+                runtime::ClassInstance* instance = reg(in.b).TryAs<runtime::ClassInstance>();
+                if (instance == nullptr) {
+                    throw runtime_error("Variable is not class"s);
+                }
+                runtime::ObjectHolder* field = instance->FindField(name, function.field_caches[in.d]);
+                if (field == nullptr) {
+                    throw runtime_error("Variable "s + name.Name() + " not found"s);
+                }
+                reg(in.a) = *field;
+                break;
+            }
+            case OpCode::SetField: {
+                runtime::ClassInstance* instance = reg(in.a).TryAs<runtime::ClassInstance>();
+                if (instance == nullptr) {
+                    throw runtime_error("Object is not class"s);
+                }
+                instance->SetField(function.names[in.b], reg(in.c), function.field_caches[in.d]);
+                break;
+            }
+            case OpCode::Add:
+                reg(in.a) = Add(reg(in.b), reg(in.c));
+                break;
+            case OpCode::Sub:
+                reg(in.a) = NumberOperation(reg(in.b), reg(in.c), runtime::SubtractNumbers);
+                break;
+            case OpCode::Mult:
+                reg(in.a) = NumberOperation(reg(in.b), reg(in.c), runtime::MultiplyNumbers);
+                break;
+            case OpCode::Div:
+                reg(in.a) = NumberOperation(reg(in.b), reg(in.c), runtime::DivideNumbers);
+                break;
+            case OpCode::Equal:
+                reg(in.a) = ObjectHolder::Own(runtime::Bool(Equal(reg(in.b), reg(in.c))));
+                break;
+            case OpCode::NotEqual:
+                reg(in.a) = ObjectHolder::Own(runtime::Bool(!Equal(reg(in.b), reg(in.c))));
+                break;
+            case OpCode::Less:
+                reg(in.a) = ObjectHolder::Own(runtime::Bool(Less(reg(in.b), reg(in.c))));
+                break;
+            case OpCode::Greater:
+                reg(in.a) = ObjectHolder::Own(runtime::Bool(
+                    !(Less(reg(in.b), reg(in.c)) || Equal(reg(in.b), reg(in.c)))));
+                break;
+            case OpCode::LessOrEqual:
+                reg(in.a) = ObjectHolder::Own(runtime::Bool(
+                    Less(reg(in.b), reg(in.c)) || Equal(reg(in.b), reg(in.c))));
+                break;
+            case OpCode::GreaterOrEqual:
+                reg(in.a) = ObjectHolder::Own(runtime::Bool(!Less(reg(in.b), reg(in.c))));
+                break;
+            case OpCode::Not:
+                reg(in.a) = ObjectHolder::Own(runtime::Bool(
+                    !ExpectBool(reg(in.b), "Cannot execute unary operation").GetValue()));
+                break;
+            case OpCode::AsBool:
+                reg(in.a) = ObjectHolder::Own(runtime::Bool(
+                    ExpectBool(reg(in.b), "Cannot execute logic binary operation").GetValue()));
+                break;
+            case OpCode::Jump:
+                pc = in.a - 1;
+                break;
+            case OpCode::JumpIfFalse:
+                if (!runtime::IsTrue(reg(in.b))) {
+                    pc = in.a - 1;
+                }
+                break;
+            case OpCode::JumpIfBool:
+                if (ExpectBool(reg(in.b), "Cannot execute logic binary operation").GetValue() == (in.c != 0)) {
+                    pc = in.a - 1;
+                }
+                break;
+            case OpCode::CheckMethod:
+                Resolve(reg(in.b), function.call_sites[in.c]);
+                break;
+            case OpCode::Call: {
+                const CallSite& site = function.call_sites[in.c];
+                ObjectHolder self = reg(in.b);
+                Resolve(self, site);
+                ObjectHolder result = Invoke(self, site, base + in.d);
+                reg(in.a) = move(result);
+                break;
+            }
+            case OpCode::NewInstance:
+                reg(in.a) = ObjectHolder::Own(runtime::ClassInstance(
+                    *function.constants[in.b].TryAs<runtime::Class>()));
+                break;
+            case OpCode::Stringify: {
+                const ObjectHolder& value = reg(in.b);
+                if (value) {
+                    ostringstream os;
+                    Print(value, os);
+                    reg(in.a) = ObjectHolder::Own(runtime::String(os.str()));
+                }
+                else {
+                    reg(in.a) = ObjectHolder::Own(runtime::String(NONE_OBJECT));
+                }
+                break;
+            }
+            case OpCode::PrintArg: {
+                ObjectHolder value = reg(in.b);
+                ostream& os = context_.GetOutputStream();
+                if (in.c != 0) {
+                    os << ' ';
+                }
+                Print(value, os);
+                break;
+            }
+            case OpCode::PrintEnd:
+                context_.GetOutputStream() << '\n';
+                break;
+            case OpCode::Return:
+                return reg(in.a);
+            }
+        }
+    }
+
+    ObjectHolder VirtualMachine::Add(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        if (lhs.GetType() == runtime::ObjectType::ClassInstance) {
+            return CallMethod(lhs, runtime::SpecialMethod::Add, { rhs });
+        }
+        return runtime::Add(lhs, rhs, context_);
+    }
+
+    bool VirtualMachine::Equal(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        if (lhs.GetType() == runtime::ObjectType::ClassInstance) {
+            return runtime::IsTrue(CallMethod(lhs, runtime::SpecialMethod::Eq, { rhs }));
+        }
+        return runtime::Equal(lhs, rhs, context_);
+    }
+
+    bool VirtualMachine::Less(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        if (lhs.GetType() == runtime::ObjectType::ClassInstance) {
+            return runtime::IsTrue(CallMethod(lhs, runtime::SpecialMethod::Less, { rhs }));
+        }
+        return runtime::Less(lhs, rhs, context_);
+    }
+
+    void VirtualMachine::Print(const ObjectHolder& object, std::ostream& os) {
+        if (!object) {
+            os << NONE_OBJECT;
+            return;
+        }
+        runtime::ClassInstance* instance = object.TryAs<runtime::ClassInstance>();
+        if (instance != nullptr && instance->HasMethod(runtime::SpecialMethod::Str, 0U)) {
+            Print(CallMethod(object, runtime::SpecialMethod::Str, {}), os);
+            return;
+        }
+        object->Print(os, context_);
+    }
+
+    void Execute(const runtime::Executable& program, runtime::Closure& closure, runtime::Context& context) {
+        std::unique_ptr<bytecode::Program> compiled = bytecode::Compile(program);
+        VirtualMachine(*compiled, context).Run(closure);
+    }
+
+    void Execute(const runtime::Executable& statement, bytecode::Program& program, runtime::Closure& closure,
+        runtime::Context& context) {
+        program.SetMain(bytecode::CompileMain(statement));
+        VirtualMachine(program, context).Run(closure);
+    }
+
+}  // namespace vm
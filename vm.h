@@ -0,0 +1,62 @@
+#pragma once
+
+#include "bytecode.h"
+#include "runtime.h"
+
+#include <string>
+#include <vector>
+
+namespace vm {
+
+    // Регистровая виртуальная машина, исполняющая байткод bytecode::Program.
+    // Регистры всех активных вызовов лежат в одном стеке, кадр вызова - непрерывный участок стека
+    class VirtualMachine {
+    public:
+        VirtualMachine(const bytecode::Program& program, runtime::Context& context);
+
+        // Исполняет программу верхнего уровня. Перед запуском переменные программы получают
+        // значения одноимённых элементов closure, после завершения их значения записываются в closure
+        void Run(runtime::Closure& closure);
+
+        // Вызывает у объекта self метод method с аргументами args
+        runtime::ObjectHolder CallMethod(const runtime::ObjectHolder& self, runtime::Symbol method,
+            const std::vector<runtime::ObjectHolder>& args);
+        // Вызывает у объекта self специальный метод method, найденный классом заранее
+        runtime::ObjectHolder CallMethod(const runtime::ObjectHolder& self, runtime::SpecialMethod method,
+            const std::vector<runtime::ObjectHolder>& args);
+
+    private:
+        const bytecode::Program& program_;
+        runtime::Context& context_;
+        std::vector<runtime::ObjectHolder> stack_;
+
+        // Исполняет функцию, кадр которой начинается с позиции base стека
+        runtime::ObjectHolder Execute(const bytecode::Function& function, size_t base);
+
+        // Вызывает у объекта self метод resolved. Если метод не найден или число аргументов
+        // не совпадает с числом его параметров, выбрасывает runtime_error
+        runtime::ObjectHolder CallResolved(const runtime::ObjectHolder& self, const runtime::Method* resolved,
+            const std::vector<runtime::ObjectHolder>& args);
+
+        // Выполняет вызов разрешённого метода. Аргументы вызова берутся из стека начиная с позиции args
+        runtime::ObjectHolder Invoke(const runtime::ObjectHolder& self, const bytecode::CallSite& site,
+            size_t args);
+
+        // Находит метод для точки вызова, используя и обновляя её кэш
+        void Resolve(const runtime::ObjectHolder& object, const bytecode::CallSite& site);
+
+        runtime::ObjectHolder Add(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs);
+        bool Equal(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs);
+        bool Less(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs);
+        void Print(const runtime::ObjectHolder& object, std::ostream& os);
+    };
+
+    // Компилирует дерево program в байткод и исполняет его виртуальной машиной
+    void Execute(const runtime::Executable& program, runtime::Closure& closure, runtime::Context& context);
+
+    // Компилирует инструкцию statement как программу верхнего уровня program и исполняет её.
+    // Тела методов, скомпилированные при исполнении предыдущих инструкций, используются повторно
+    void Execute(const runtime::Executable& statement, bytecode::Program& program, runtime::Closure& closure,
+        runtime::Context& context);
+
+}  // namespace vm
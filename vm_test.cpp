@@ -0,0 +1,292 @@
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+#include "test_runner_p.h"
+#include "vm.h"
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+
+string RunAst(const string& program, size_t max_call_depth = runtime::Context::DEFAULT_MAX_CALL_DEPTH) {
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    context.SetMaxCallDepth(max_call_depth);
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    return context.output.str();
+}
+
+string RunVm(const string& program, size_t max_call_depth = runtime::Context::DEFAULT_MAX_CALL_DEPTH) {
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    context.SetMaxCallDepth(max_call_depth);
+    runtime::Closure closure;
+    Execute(*tree, closure, context);
+    return context.output.str();
+}
+
+void TestArithmeticsAndLogic() {
+    const string program = R"(
+a = 1
+b = 2
+c = 3
+print a + b * c - 4 / 2, -a, (a + b) * c
+print a < b, a > b, a <= a, b >= c, a == 1, a != 1
+print a + b > c and a + c > b or not b + c > a
+print 'abc' < 'abd', 'x' + 'y', str(a) + str(None) + str(True)
+)"s;
+    ASSERT_EQUAL(RunVm(program), RunAst(program));
+    ASSERT_EQUAL(RunVm(program), "5 -1 9\nTrue False True False True False\nFalse\nTrue xy 1NoneTrue\n"s);
+}
+
+void TestMethodsAndRecursion() {
+    const string program = R"(
+class GCD:
+  def __init__():
+    self.call_count = 0
+
+  def calc(a, b):
+    self.call_count = self.call_count + 1
+    if a < b:
+      return self.calc(b, a)
+    if b == 0:
+      return a
+    return self.calc(a - b, b)
+
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+x = GCD()
+print x.calc(510510, 18629977)
+print x.calc(22, 17)
+print x.call_count
+f = Fib()
+print f.calc(15)
+)"s;
+    ASSERT_EQUAL(RunVm(program), RunAst(program));
+    ASSERT_EQUAL(RunVm(program), "17\n1\n115\n610\n"s);
+}
+
+void TestPolymorphismAndOperators() {
+    const string program = R"(
+class Shape:
+  def __str__():
+    return "Shape"
+
+  def area():
+    return 'Not implemented'
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+
+  def __str__():
+    return "Rect(" + str(self.w) + 'x' + str(self.h) + ')'
+
+  def area():
+    return self.w * self.h
+
+class Money:
+  def __init__(value):
+    self.value = value
+
+  def __add__(rhs):
+    return self.value + rhs.value
+
+  def __eq__(rhs):
+    return self.value == rhs.value
+
+  def __lt__(rhs):
+    return self.value < rhs.value
+
+  def __str__():
+    return str(self.value) + '$'
+
+s = Shape()
+r = Rect(10, 20)
+print s, r, s.area(), r.area()
+m = Money(Money(5) + Money(7))
+print m, m == Money(12), m < Money(3), m > Money(3), m <= Money(12), m >= Money(13)
+p = Money(1)
+p = Money(p.value + 1)
+print p
+print Rect
+)"s;
+    ASSERT_EQUAL(RunVm(program), RunAst(program));
+}
+
+void TestLongChains() {
+    // Цепочки компилируются без рекурсии, промежуточные значения занимают один регистр
+    string program = "x = 3\ny = 0"s;
+    for (int i = 0; i < 2000; ++i) {
+        program += " + x * 2 - x"s;
+    }
+    program += "\nprint y, y > 0"s;
+    for (int i = 0; i < 2000; ++i) {
+        program += " and x != 1"s;
+    }
+    program += "\n"s;
+    ASSERT_EQUAL(RunVm(program), RunAst(program));
+    ASSERT_EQUAL(RunVm(program), "6000 True\n"s);
+}
+
+void TestCallDepthLimit() {
+    const string program = R"(
+class Counter:
+  def count(n):
+    if n == 0:
+      return 0
+    return 1 + self.count(n - 1)
+
+c = Counter()
+print c.count(50)
+)"s;
+    ASSERT_EQUAL(RunVm(program, 51), "50\n"s);
+    ASSERT_EQUAL(RunAst(program, 51), "50\n"s);
+    ASSERT_THROWS(RunVm(program, 50), runtime_error);
+    ASSERT_THROWS(RunAst(program, 50), runtime_error);
+}
+
+void TestConditions() {
+    // Условие любого типа приводится к логическому значению одинаково в обоих движках
+    const string program = R"(
+class Empty:
+  def get():
+    return 1
+
+e = Empty()
+for_none = None
+if e:
+  print 'instance'
+else:
+  print 'no instance'
+if Empty:
+  print 'class'
+else:
+  print 'no class'
+if for_none:
+  print 'none'
+else:
+  print 'no none'
+if 'a':
+  print 'string'
+if '':
+  print 'empty string'
+if 2:
+  print 'number'
+if 0:
+  print 'zero'
+)"s;
+    ASSERT_EQUAL(RunVm(program), RunAst(program));
+    ASSERT_EQUAL(RunAst(program), "no instance\nno class\nno none\nstring\nnumber\n"s);
+}
+
+void TestSelfOfTemporary() {
+    // Метод временного объекта возвращает self, который должен пережить вызов
+    const string program = R"(
+class Foo:
+  def __init__():
+    self.v = 5
+
+  def __add__(o):
+    return self
+
+x = Foo() + 1
+print x.v
+)"s;
+    ASSERT_EQUAL(RunVm(program), RunAst(program));
+    ASSERT_EQUAL(RunAst(program), "5\n"s);
+}
+
+void TestDivisionByZero() {
+    // Оба движка сообщают о делении на 0 исключением, а не сигналом
+    for (const string& program : {"print 1 / 0\n"s, "x = 0\nprint 5 / x\n"s}) {
+        ASSERT_THROWS(RunAst(program), runtime_error);
+        ASSERT_THROWS(RunVm(program), runtime_error);
+    }
+    ASSERT_EQUAL(RunVm("print 7 / -2\n"s), RunAst("print 7 / -2\n"s));
+}
+
+void TestIntegerOverflow() {
+    // Переполнение 64-битных чисел - ошибка исполнения в обоих движках
+    const string max = "9223372036854775807"s;
+    const string min = "(-" + max + " - 1)"s;
+    for (const string& expression : {max + " + 1"s, min + " - 1"s, max + " * 2"s, "-" + min, min + " / -1"s}) {
+        const string program = "print " + expression + "\n"s;
+        ASSERT_THROWS(RunAst(program), runtime_error);
+        ASSERT_THROWS(RunVm(program), runtime_error);
+    }
+    const string program = "print " + max + " - 1 + 1, " + min + " + 1 - 1, " + min + " / 1\n"s;
+    ASSERT_EQUAL(RunVm(program), RunAst(program));
+    ASSERT_EQUAL(RunAst(program), max + " -9223372036854775808 -9223372036854775808\n"s);
+}
+
+void TestUnboundVariable() {
+    const string program = R"(
+x = 1
+if x > 1:
+  y = 2
+print y
+)"s;
+    ASSERT_THROWS(RunVm(program), runtime_error);
+}
+
+void TestClosureSync() {
+    istringstream is("y = x + 1\n"s);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure = {{"x"s, runtime::ObjectHolder::Own(runtime::Number(41))}};
+    Execute(*tree, closure, context);
+
+    ASSERT(closure.count("y"s) == 1);
+    ASSERT_EQUAL(closure.at("y"s).TryAs<runtime::Number>()->GetValue(), 42);
+}
+
+void TestTreeMethodFallback() {
+    // Тело метода, не являющееся ast::MethodBody, исполняется деревом
+    vector<runtime::Method> methods;
+    methods.push_back({"get"s, {}, make_unique<ast::NumericConst>(runtime::Number(57))});
+    runtime::Class cls("Boxed"s, std::move(methods), nullptr);
+
+    ast::Print program(make_unique<ast::MethodCall>(make_unique<ast::NewInstance>(cls), "get"s,
+                                                    vector<unique_ptr<ast::Statement>>{}));
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    Execute(program, closure, context);
+    ASSERT_EQUAL(context.output.str(), "57\n"s);
+}
+
+}  // namespace
+
+void RunVmTests(TestRunner& tr) {
+    RUN_TEST(tr, vm::TestArithmeticsAndLogic);
+    RUN_TEST(tr, vm::TestMethodsAndRecursion);
+    RUN_TEST(tr, vm::TestPolymorphismAndOperators);
+    RUN_TEST(tr, vm::TestLongChains);
+    RUN_TEST(tr, vm::TestCallDepthLimit);
+    RUN_TEST(tr, vm::TestConditions);
+    RUN_TEST(tr, vm::TestSelfOfTemporary);
+    RUN_TEST(tr, vm::TestDivisionByZero);
+    RUN_TEST(tr, vm::TestIntegerOverflow);
+    RUN_TEST(tr, vm::TestUnboundVariable);
+    RUN_TEST(tr, vm::TestClosureSync);
+    RUN_TEST(tr, vm::TestTreeMethodFallback);
+}
+
+}  // namespace vm